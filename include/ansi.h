@@ -0,0 +1,38 @@
+#ifndef ANSI_H
+#define ANSI_H
+
+#include <stddef.h>
+
+#include "damage.h"
+#include "rain.h"
+
+/* Encodes draw lists as VT100/ANSI escape sequences into a reusable byte
+ * buffer. It remembers where the terminal cursor is and which color is
+ * selected, so a frame only carries the cursor moves and SGR changes it
+ * actually needs.
+ */
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t capacity;
+
+    int width;
+    int cursor_row; // -1 when the terminal cursor position is unknown
+    int cursor_col;
+    int color;      // Palette shade currently selected, -1 when unknown
+} AnsiBuffer;
+
+int ansi_buffer_init(AnsiBuffer *buf, int width);
+void ansi_buffer_free(AnsiBuffer *buf);
+
+/* Start a new frame: drop the bytes of the previous one, keep cursor and color state. */
+void ansi_begin_frame(AnsiBuffer *buf);
+
+/* Forget cursor and color, e.g. after something else wrote to the terminal. */
+void ansi_invalidate(AnsiBuffer *buf);
+
+int ansi_append(AnsiBuffer *buf, const char *bytes, size_t len);
+int ansi_encode(AnsiBuffer *buf, const DrawList *list, const Palette *palette);
+
+#endif // !ANSI_H
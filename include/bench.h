@@ -0,0 +1,25 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+
+#include "ini_parser.h"
+#include "render.h"
+
+typedef struct
+{
+    long frames;
+    int width;
+    int height;
+    bool paced; // Sleep between frames as the real loop does, to measure pacing
+    const char *record; // Also record the run to this file, NULL for none
+} BenchOptions;
+
+/* Run the simulation headless and print frame statistics. The renderer
+ * writes into a scratch file instead of a TTY, so its cost and the bytes
+ * it would send are measured too. Paced runs also report how well the
+ * frame scheduler kept to refresh_rate.
+ */
+int bench_run(const Settings *settings, const BenchOptions *options, const Renderer *renderer);
+
+#endif // !BENCH_H
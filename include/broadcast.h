@@ -0,0 +1,29 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <signal.h>
+
+#include "ini_parser.h"
+
+// Frames a client may fall behind before its backlog is dropped and it resyncs from a keyframe
+#define BROADCAST_MAX_BACKLOG 16
+
+/* Where a server listens or a client connects: a Unix domain socket path
+ * (anything with a '/'), or HOST:PORT / :PORT over TCP.
+ */
+
+/* Run one simulation of width x height and stream it to every client that
+ * connects, until *stop is set. Each frame's diff is encoded to ANSI once
+ * and the same bytes are queued to all clients. A client that joins, or
+ * falls more than BROADCAST_MAX_BACKLOG frames behind, gets a keyframe (the
+ * whole screen) instead, so a slow one never holds the others up.
+ */
+int broadcast_serve(const Settings *settings, const char *address, int width, int height,
+                    const volatile sig_atomic_t *stop);
+
+/* Take over the terminal and copy the server's stream onto it until the
+ * server goes away or *stop is set.
+ */
+int broadcast_connect(const char *address, const volatile sig_atomic_t *stop);
+
+#endif // !BROADCAST_H
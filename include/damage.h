@@ -0,0 +1,63 @@
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "grid.h"
+
+/* One terminal write. An erase is stored as GLYPH_EMPTY with color_pair 0,
+ * and cells tells how many columns the write covers. Eight bytes with no
+ * padding: recordings store draw lists as they are (see recording.h).
+ */
+typedef struct
+{
+    uint16_t row;
+    uint16_t col;
+    uint16_t glyph;
+    uint8_t color_pair;
+    uint8_t cells;
+} DrawOp;
+
+typedef struct
+{
+    DrawOp *ops;
+    size_t count;
+    size_t capacity;
+} DrawList;
+
+/* What the terminal is currently showing. The simulation grid is the back
+ * buffer; diffing its dirty spans against this front copy yields the writes
+ * for a frame, so output scales with what changed rather than with how many
+ * cells the simulation touched.
+ */
+typedef struct
+{
+    Grid front;
+    DrawList list;        // Writes from the last diff, in row-major order
+    size_t cells_changed; // Cells those writes cover
+} FrontBuffer;
+
+/* Make room for extra more ops. */
+int draw_list_reserve(DrawList *list, size_t extra);
+
+int front_buffer_init(FrontBuffer *fb, int width, int height, GridLayout layout);
+void front_buffer_free(FrontBuffer *fb);
+
+/* Record a write for every dirty cell where back differs from the front
+ * copy, bring the front copy up to date and clear the dirty map.
+ */
+int front_buffer_diff(FrontBuffer *fb, const Grid *back, DirtyMap *dirty);
+
+/* The terminal was cleared behind our back: treat every cell as blank. */
+void front_buffer_reset(FrontBuffer *fb);
+
+/* Something else drew over row: the next diff of its dirty cells writes
+ * every one of them, blank or not.
+ */
+void front_buffer_invalidate_row(FrontBuffer *fb, int row);
+
+/* Match a new terminal size; the front copy comes back blank. */
+int front_buffer_resize(FrontBuffer *fb, int width, int height);
+
+#endif // !DAMAGE_H
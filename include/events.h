@@ -0,0 +1,62 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdint.h>
+
+// Most extra descriptors an EventLoop wakes up for; see event_loop_watch()
+#define EVENT_LOOP_MAX_WATCHED 4
+
+// Keys one wait hands back at most; the rest are read on the next one
+#define EVENT_LOOP_MAX_KEYS 32
+
+typedef enum
+{
+    EVENT_FRAME = 1 << 0,  // The deadline passed
+    EVENT_RESIZE = 1 << 1, // SIGWINCH
+    EVENT_QUIT = 1 << 2,   // SIGINT or SIGTERM
+} EventFlags;
+
+typedef struct
+{
+    int flags; // EventFlags
+    unsigned char keys[EVENT_LOOP_MAX_KEYS]; // Bytes typed on the input, as they came
+    int key_count;
+} Events;
+
+/* Everything the live animation waits on, in one blocking call: the next
+ * frame's deadline, signals, keys typed on the terminal and descriptors such
+ * as the settings watch. On Linux that is an epoll set of a timerfd, a
+ * signalfd and the rest; elsewhere poll() with a self-pipe the signal
+ * handlers write to. Between events the process sleeps in the kernel.
+ */
+typedef struct
+{
+    int input_fd; // -1 once it reached end of file, or when it can't be waited on
+    int signal_fd; // signalfd, or the read end of the self-pipe
+    int timer_fd;  // -1 without timerfd
+    int epoll_fd;  // -1 without epoll
+    int64_t armed_ns; // Deadline the timer is set to, -1 when disarmed
+    int watched[EVENT_LOOP_MAX_WATCHED];
+    int watched_count;
+} EventLoop;
+
+/* Take over SIGWINCH, SIGINT and SIGTERM and read keys from input_fd (-1 for
+ * none). On Linux the signals are blocked, so this has to run before any
+ * thread is started for the process to receive them here.
+ */
+int event_loop_init(EventLoop *loop, int input_fd);
+
+/* Give the signals back and close the descriptors. */
+void event_loop_free(EventLoop *loop);
+
+/* Also wake up when fd becomes readable; the caller reads it. */
+int event_loop_watch(EventLoop *loop, int fd);
+
+/* Block until something happens: deadline_ns (CLOCK_MONOTONIC) passes, a
+ * signal comes in, a key is typed or a watched descriptor is readable.
+ * deadline_ns 0 only collects what is already pending and reports the frame
+ * due; -1 waits with no deadline at all. Returns 0, or -1 on error.
+ */
+int event_loop_wait(EventLoop *loop, int64_t deadline_ns, Events *events);
+
+#endif // !EVENTS_H
@@ -0,0 +1,17 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <stdint.h>
+#include <wchar.h>
+
+#define FONT_WIDTH 5
+#define FONT_HEIGHT 7
+
+/* The built-in bitmap font of the pixel renderers: printable ASCII, the
+ * halfwidth katakana and the rest of the default rain symbols. A glyph is
+ * FONT_HEIGHT rows of one byte each, bit FONT_WIDTH - 1 the leftmost
+ * column. NULL when ch is not covered.
+ */
+const uint8_t *font_glyph(wchar_t ch);
+
+#endif // !FONT_H
@@ -0,0 +1,119 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The color plane holds the palette shade (a ColorPair with COLORS_BASIC) in its low bits plus these flags
+#define CELL_COLOR_MASK 0x3f
+#define CELL_WIDE 0x40 // Leading half of a double-width glyph
+#define CELL_CONT 0x80 // Trailing half; the glyph starts one column to the left
+
+typedef enum
+{
+    GRID_ROW_MAJOR = 0,
+    GRID_COLUMN_MAJOR,
+    GRID_TILED
+} GridLayout;
+
+// A tiled grid is stored in squares of GRID_TILE_SIZE cells a side, each one whole pages of either plane
+#define GRID_TILE_SHIFT 6
+#define GRID_TILE_SIZE (1 << GRID_TILE_SHIFT)
+#define GRID_TILE_CELLS (GRID_TILE_SIZE * GRID_TILE_SIZE)
+
+/* The screen contents as one contiguous allocation: a palette index plane
+ * and a color plane, 3 bytes per cell. Column-major keeps a trail's cells
+ * adjacent in memory; row-major keeps a screen row adjacent.
+ *
+ * Tiled is for canvases far bigger than a screen and mostly blank: the
+ * planes go tile after tile, row-major within a tile, and are only reserved
+ * address space. A tile's pages are allocated the first time something is
+ * written to it and handed back by grid_release_tile() once it is blank
+ * again, so memory follows the tiles in use rather than the area.
+ */
+typedef struct
+{
+    int width;
+    int height;
+    GridLayout layout;
+    size_t row_stride; // Not used when tiled
+    size_t col_stride;
+    int tiles_x;  // Tiles per row of tiles, when tiled
+    int tiles_y;
+    size_t cells; // In each plane; tiled, the tiles' padding past the edges is included
+
+    uint16_t *glyph; // Palette index, GLYPH_EMPTY for a blank cell
+    uint8_t *color;  // Shade the cell was last drawn with, 0 when blank
+} Grid;
+
+/* Columns [lo, hi) of one row that may have changed; clean when lo >= hi. */
+typedef struct
+{
+    int lo;
+    int hi;
+} DirtySpan;
+
+/* Which cells were written since the last diff: a span per row bounding
+ * them, and one bit per cell so scattered writes in a wide span don't force
+ * a scan of every cell between them.
+ */
+typedef struct
+{
+    DirtySpan *spans;
+    uint64_t *bits; // Row-major, words_per_row words per row
+    size_t words_per_row;
+} DirtyMap;
+
+int dirty_map_init(DirtyMap *dirty, int width, int height);
+void dirty_map_free(DirtyMap *dirty);
+
+/* Widen the span of row to cover [lo, hi), leaving the bits alone. */
+static inline void dirty_map_mark_span(DirtyMap *dirty, int row, int lo, int hi)
+{
+    DirtySpan *span = &dirty->spans[row];
+    if (lo < span->lo)
+        span->lo = lo;
+    if (hi > span->hi)
+        span->hi = hi;
+}
+
+static inline void dirty_map_mark(DirtyMap *dirty, int row, int lo, int hi)
+{
+    dirty_map_mark_span(dirty, row, lo, hi);
+
+    uint64_t *bits = dirty->bits + row * dirty->words_per_row;
+    for (int col = lo; col < hi; col++)
+        bits[col / 64] |= (uint64_t)1 << (col % 64);
+}
+
+int grid_init(Grid *grid, int width, int height, GridLayout layout);
+void grid_free(Grid *grid);
+size_t grid_bytes(const Grid *grid);
+
+/* Give the pages of a blank tile back; it reads as blank and is allocated
+ * again on its next write.
+ */
+void grid_release_tile(Grid *grid, size_t tile);
+
+/* Zeroed address space for bytes, backed by memory a page at a time as it
+ * is written: the planes of a tiled grid and per-cell data laid out like them.
+ * grid_release() gives back the whole pages of a range that is zero again.
+ */
+void *grid_reserve(size_t bytes);
+void grid_release(void *memory, size_t bytes);
+void grid_unreserve(void *memory, size_t bytes);
+
+static inline size_t grid_tile(const Grid *grid, int row, int col)
+{
+    return (size_t)(row >> GRID_TILE_SHIFT) * grid->tiles_x + (col >> GRID_TILE_SHIFT);
+}
+
+static inline size_t grid_index(const Grid *grid, int row, int col)
+{
+    if (grid->layout == GRID_TILED)
+        return grid_tile(grid, row, col) * GRID_TILE_CELLS + ((row & (GRID_TILE_SIZE - 1)) << GRID_TILE_SHIFT) +
+               (col & (GRID_TILE_SIZE - 1));
+    return (size_t)row * grid->row_stride + (size_t)col * grid->col_stride;
+}
+
+#endif // !GRID_H
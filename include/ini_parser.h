@@ -6,19 +6,70 @@
 #include <string.h>
 #include <ini.h>
 #include <wchar.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "grid.h"
+#include "palette.h"
+#include "scheduler.h"
 
 #define MATCH(s, n) strcmp(section, s) == 0 && strcmp(name, n) == 0
 
 #define MESSAGE_MAX_LENGTH 2048
+#define SYMBOLS_MAX_LENGTH 256
+#define RENDERER_NAME_LENGTH 16
+#define SETTINGS_ERROR_LENGTH 128
+#define STATS_SOCKET_PATH_LENGTH 108 // sockaddr_un.sun_path
+#define SHM_EXPORT_NAME_LENGTH 64
+#define CANVAS_MAX_SIZE 50000
 
 typedef struct
 {
     wchar_t message[MESSAGE_MAX_LENGTH];
-    int refresh_rate;
+    wchar_t symbols[SYMBOLS_MAX_LENGTH]; // Rain symbol set; empty means the built-in one
+    int refresh_rate; // Frame period in milliseconds
     int message_spawn_frame_interval;
     int max_trail_length;
+    double spawn_density; // Random trails started per frame for every 100 columns
+    double min_speed; // Rows a trail falls per frame; each trail gets a speed between these two
+    double max_speed;
+    double flicker_rate; // Percent of trail body cells that change glyph each frame
+    int flicker_budget; // Most glyphs flicker changes in a frame; 0 turns it off
+    int grid_layout; // GridLayout
+    int canvas_width; // Cells the rain falls over when more than the terminal shows; 0 for the terminal's width
+    int canvas_height;
+    int viewport; // ViewportMode: how the terminal's view moves over a canvas
+    int viewport_x; // Top left cell of a fixed view, and where the others start
+    int viewport_y;
+    double pan_speed; // Columns per frame a panning view moves
+    char renderer[RENDERER_NAME_LENGTH]; // Output backend; empty means ncurses
+    int frame_policy; // FramePolicy: what a frame that overran its deadline does
+    int threads; // Simulation threads; above one, output gets a thread of its own too
+    uint64_t seed; // Fixes every random choice, so runs at one size replay identically; 0 picks one
+    int colors; // ColorMode: the four original colors or a finer 256-color / truecolor gradient
+    bool load_shedding; // Thin the rain out while the terminal can't keep up
+    int output_budget; // Bytes per second the output may use before shedding; 0 for no limit
+    bool hud; // Status line with frame times, trail and output counts over the bottom row
+    char stats_socket[STATS_SOCKET_PATH_LENGTH]; // Unix socket serving the same stats as JSON; empty for none
+    char shm_export[SHM_EXPORT_NAME_LENGTH]; // POSIX shared memory object every frame is published to; empty for none
+
+    char error[SETTINGS_ERROR_LENGTH]; // First value handler() rejected, empty if none
+    char warning[SETTINGS_ERROR_LENGTH]; // First setting handler() did not know and skipped, empty if none
 } Settings;
 
+/* The values used for anything settings.ini leaves out. */
+void settings_defaults(Settings *settings);
+
+/* A whole-string seed, decimal or 0x hex, from 0 to 2^64 - 1; 0 on success,
+ * -1 for anything else, a sign included. Shared with --seed.
+ */
+int parse_seed(const char *text, uint64_t *seed);
+
+/* inih callback. Rejects out-of-range values, so that a loaded Settings is
+ * always safe to run with, and records why in settings->error. Settings it
+ * does not know, such as ones an older or newer version used, are skipped
+ * and noted in settings->warning.
+ */
 int handler(void *user, const char *section, const char *name, const char *value);
 
 #endif // !INI_PARSER_H
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "damage.h"
+#include "rain.h"
+#include "render.h"
+
+// Frame time histogram: bucket i counts frames that took under 2^i microseconds, the last one all slower ones
+#define METRICS_BUCKETS 22
+
+// The HUD's rates cover the last complete window of this length
+#define METRICS_WINDOW_NS 1000000000LL
+
+typedef struct
+{
+    uint64_t frames;
+    uint64_t steps; // Simulation steps; more than frames while catching up
+    uint64_t frame_ns; // Time spent on frames, sleeps excluded
+    uint64_t spawn_attempts;
+    uint64_t spawns;
+    uint64_t cells_drawn;
+    uint64_t cells_erased;
+    uint64_t cells_changed; // What the diffs sent, after unchanged writes were dropped
+    uint64_t bytes_written;
+} MetricsCounters;
+
+/* What the main loop costs, for the HUD and the stats socket. Nothing here
+ * runs unless one of them is on; the simulation only keeps per-frame
+ * counts it would keep anyway.
+ */
+typedef struct
+{
+    MetricsCounters total;
+    uint64_t frame_buckets[METRICS_BUCKETS];
+    uint64_t frame_ns_max;
+    size_t active_trails; // As of the last frame
+    size_t max_trails;
+    int load_level; // Rain.load_level as of the last frame
+    bool bytes_known; // The renderer counts its output; see Renderer.bytes_written
+
+    int64_t frame_start_ns;
+    int64_t window_start_ns;
+    MetricsCounters window_start; // total when the current window began
+    MetricsCounters last_window;  // Growth of total over the last complete window
+    int64_t last_window_ns;
+} Metrics;
+
+void metrics_init(Metrics *metrics, const Renderer *renderer);
+
+/* Bracket a frame: begin before its first step, end once it is handed to
+ * the renderer. metrics_step() follows every rain_step(), whose counts only
+ * last until the next one.
+ */
+void metrics_begin_frame(Metrics *metrics);
+void metrics_step(Metrics *metrics, const Rain *rain);
+void metrics_end_frame(Metrics *metrics, const Rain *rain, const FrontBuffer *front, const Renderer *renderer);
+
+/* Upper bound in microseconds of the frame time below which fraction of
+ * frames fall, as far as the histogram tells; 0 before the first frame.
+ */
+uint64_t metrics_percentile_us(const Metrics *metrics, double fraction);
+
+/* One status line drawn over the bottom row of the screen. Its characters
+ * are added to the palette like message characters, and only the ones that
+ * changed since the last frame are sent.
+ */
+typedef struct
+{
+    bool enabled;
+    uint16_t glyphs[128]; // Palette glyph of each printable ASCII character
+    uint16_t *shown; // Per column, what the row shows; GLYPH_EMPTY for blanks
+    int row;         // Row it was drawn on, -1 when nothing is shown
+    int width;       // Columns of shown
+} Hud;
+
+void hud_init(Hud *hud);
+void hud_free(Hud *hud);
+
+/* Start drawing it, adding its characters to palette: 1 when the palette
+ * grew, 0 when they were there already, -1 when out of memory.
+ */
+int hud_show(Hud *hud, Palette *palette);
+
+/* Stop drawing it: the row is diffed in full again so the rain underneath reappears. */
+void hud_hide(Hud *hud, FrontBuffer *front, DirtyMap *dirty);
+
+/* The screen was cleared; draw every character again. */
+void hud_invalidate(Hud *hud);
+
+/* Replace the writes to the bottom row in front->list with the HUD line. */
+int hud_draw(Hud *hud, const Metrics *metrics, FrontBuffer *front);
+
+/* Serve the stats over a Unix domain socket at path: every connection gets
+ * one JSON object and is closed, e.g. `nc -U path`. Returns the listening
+ * descriptor, -1 on error (EADDRINUSE when path is taken by anything but a
+ * dead socket).
+ */
+int stats_socket_open(const char *path);
+void stats_socket_close(int fd, const char *path);
+
+/* Remove the socket at path if it was left over by a run that did not get to
+ * clean up: only a socket no server accepts connections on any more. Any
+ * other file, or a socket in use, stays, and binding to path then fails.
+ */
+void unlink_stale_socket(const char *path);
+
+/* Answer the connections waiting on fd. Never blocks. */
+void stats_socket_serve(int fd, const Metrics *metrics);
+
+#endif // !METRICS_H
@@ -0,0 +1,23 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include "ini_parser.h"
+
+typedef struct
+{
+    const char *results;  // Write the results here as TSV, NULL for none
+    const char *baseline; // Compare against results saved earlier, NULL for none
+    int threshold;        // Percent a metric may grow over the baseline before it counts as a regression
+} MicrobenchOptions;
+
+/* Time the simulation's hot paths on their own: drawing, erasing, the
+ * message overwrite check, symbol generation, spawning and a whole frame
+ * step, on grids from 80x24 to 1000x300 and with messages from none up to
+ * MESSAGE_MAX_LENGTH. Every metric is nanoseconds per operation, the median
+ * of a few runs of at least 50 ms each. Returns 1 when a metric regressed
+ * past the threshold, or on error; spawn_trails, summed from intervals too
+ * short to time well, is reported but never fails the run.
+ */
+int microbench_run(const Settings *settings, const MicrobenchOptions *options);
+
+#endif // !MICROBENCH_H
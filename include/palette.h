@@ -0,0 +1,74 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#define GLYPH_EMPTY 0        // Palette index 0 is always the blank cell
+#define GLYPH_MAX_ENCODED 8 // Bytes reserved for one symbol's multibyte encoding
+
+// Shades one color mode can have; shade indices live in the grid's CELL_COLOR_MASK bits
+#define PALETTE_MAX_SHADES 32
+
+typedef enum
+{
+    COLORS_BASIC = 0, // The four ColorPairs: white head, bright, dimmer and dark green
+    COLORS_256,       // A green ramp of xterm 256-color indices
+    COLORS_TRUECOLOR  // A finer 24-bit ramp
+} ColorMode;
+
+/* Every symbol the grid can hold, addressed by a small index. Entries
+ * 1..rain_count are the random rain symbols; message characters that are
+ * not already among them follow. The colors they are drawn in are here too:
+ * shade 1 is a trail head, higher shades are darker.
+ *
+ * Column widths and the multibyte encoding in the current locale are
+ * computed once here so nothing on the per-frame path calls wcwidth() or
+ * wcrtomb().
+ */
+typedef struct
+{
+    wchar_t *symbols;
+    uint8_t *widths;                     // 1 or 2 terminal columns
+    char (*encoded)[GLYPH_MAX_ENCODED]; // Multibyte bytes of each symbol
+    uint8_t *encoded_len;
+    size_t count;
+    size_t rain_count;
+    bool all_narrow; // No symbol is double-width
+
+    ColorMode color_mode;
+    int shade_count;                                // Shades 1..shade_count are in use
+    uint8_t shade_rgb[PALETTE_MAX_SHADES + 1][3];
+    uint8_t shade_xterm[PALETTE_MAX_SHADES + 1];    // 256-color index, for COLORS_256
+} Palette;
+
+/* Starts out with COLORS_BASIC; see palette_set_colors(). */
+int palette_init(Palette *palette, const wchar_t *rain_symbols, const wchar_t *message);
+void palette_free(Palette *palette);
+
+/* Fill in the shades of mode. They depend on nothing else, so a recording
+ * only needs to store the mode.
+ */
+void palette_set_colors(Palette *palette, ColorMode mode);
+
+/* Append the characters of message that are missing. Existing indices stay
+ * valid, so glyphs already on the grid or in a recording keep their meaning.
+ */
+int palette_extend(Palette *palette, const wchar_t *message);
+
+/* Index of ch, or GLYPH_EMPTY when it is not in the palette. Linear; startup only. */
+uint16_t palette_lookup(const Palette *palette, wchar_t ch);
+
+static inline wchar_t palette_symbol(const Palette *palette, uint16_t glyph)
+{
+    return palette->symbols[glyph];
+}
+
+static inline int palette_width(const Palette *palette, uint16_t glyph)
+{
+    return palette->widths[glyph];
+}
+
+#endif // !PALETTE_H
@@ -0,0 +1,44 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "damage.h"
+#include "render.h"
+
+/* Presents frames on a thread of its own, so frame N is simulated while
+ * frame N-1 is written to the terminal. Draw lists are swapped between the
+ * caller and the thread rather than copied.
+ */
+typedef struct
+{
+    const Renderer *renderer;
+    const Palette *palette;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    DrawList pending;   // Submitted, not yet picked up
+    DrawList presenting; // Owned by the thread while it presents
+    bool has_pending;
+    bool busy;
+    bool stop;
+} RenderPipeline;
+
+int render_pipeline_start(RenderPipeline *pipeline, const Renderer *renderer, const Palette *palette);
+
+/* Stop the thread once everything submitted is on screen. */
+void render_pipeline_stop(RenderPipeline *pipeline);
+
+/* Hand *list to the thread, waiting while the previous frame is still
+ * queued; *list comes back holding an empty list to diff the next frame into.
+ */
+void render_pipeline_submit(RenderPipeline *pipeline, DrawList *list);
+
+/* Wait until everything submitted is on screen, e.g. before the renderer is
+ * used from this thread.
+ */
+void render_pipeline_sync(RenderPipeline *pipeline);
+
+#endif // !PIPELINE_H
@@ -0,0 +1,265 @@
+#ifndef RAIN_H
+#define RAIN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#include "ini_parser.h"
+#include "grid.h"
+#include "palette.h"
+#include "workers.h"
+#include "rng.h"
+
+/* The shades of COLORS_BASIC. The other color modes keep PAIR_WHITE for a
+ * trail head and continue with more, finer shades of green.
+ */
+typedef enum
+{
+    PAIR_WHITE = 1,
+    PAIR_BRIGHT_GREEN,
+    PAIR_DIMMER_GREEN,
+    PAIR_DARK_GREEN
+} ColorPair;
+
+typedef enum
+{
+    RAIN_OK = 0,
+    RAIN_ERR_ALLOC,
+    RAIN_ERR_MESSAGE_WIDTH,
+    RAIN_ERR_MESSAGE_HEIGHT
+} RainStatus;
+
+/* Fixed-size trail storage. The hot per-trail fields are parallel arrays
+ * indexed by slot. Each RainBand lists its live slots densely in spawn order
+ * and `free_slots` is a stack of the unused ones, so spawning a trail and
+ * retiring one are both O(1) and a frame only visits live trails.
+ */
+typedef struct
+{
+    size_t capacity;
+    size_t limit; // Spawning stops at this many live trails; at most capacity
+    int *column;
+    int *head_row;
+    int *length;
+
+    size_t active_count; // Live trails over all bands
+    uint32_t *free_slots;
+    size_t free_count;
+} TrailPool;
+
+// Levels rain_set_load_level() takes, 0 to RAIN_LOAD_LEVELS - 1
+#define RAIN_LOAD_LEVELS 5
+
+// Bands start on a multiple of this many columns, so no two share a word of a bitmap
+#define RAIN_BAND_ALIGN 64
+
+// Rain symbols drawn ahead per band; four come out of each generator step
+#define RAIN_SYMBOL_BATCH 64
+
+// Trail speeds between min_speed and max_speed come in this many steps
+#define RAIN_SPEED_BUCKETS 8
+
+// Speeds and the sub-row part of trail positions are fixed point with this many fraction bits
+#define RAIN_SPEED_SHIFT 8
+
+/* A strip of columns whose trails one thread updates. Everything a trail
+ * update writes outside the grid is kept per band and folded into the Rain
+ * once all bands are done, so bands never write the same memory.
+ */
+typedef struct
+{
+    int col_lo;
+    int col_hi;
+
+    uint32_t *active[RAIN_SPEED_BUCKETS]; // Live trail slots in these columns per speed bucket, in spawn order
+    size_t active_count[RAIN_SPEED_BUCKETS];
+    uint32_t *retired; // Slots freed this frame, returned to the pool afterwards
+    size_t retired_count;
+    uint32_t *new_reveals;
+    size_t new_reveal_count;
+
+    DirtyMap dirty; // Shares its bits with Rain.dirty; own spans unless it is the only band
+    size_t cells_drawn;
+    size_t cells_erased;
+
+    Rng rng; // This band's symbols; seeded from Rain.rng
+    uint16_t symbols[RAIN_SYMBOL_BATCH];
+    int symbols_left; // Unused entries at the front of symbols
+    int64_t flicker_skip; // Trail body cells to pass over before the next one changes glyph
+
+    uint32_t *tiles; // On a tiled grid, the tiles in these columns that hold something
+    size_t tile_count;
+} RainBand;
+
+/* One character of the (possibly multi-line) message and where it lands.
+ * row is -1 while the terminal is too small to show it.
+ */
+typedef struct
+{
+    int row;
+    int col;
+    uint16_t glyph;
+} MessageCell;
+
+typedef struct Rain
+{
+    int width;
+    int height;
+    int max_trail_length;
+    int message_spawn_frame_interval;
+
+    wchar_t *message;        // Kept to lay the message out again after a resize
+    MessageCell *message_cells;
+    size_t message_len;      // Number of message cells, newlines excluded
+    bool *message_revealed;  // Per message cell; survives resizes, unlike revealed_bits
+    int *message_index;      // Per grid cell, row-major: 1 + index into message_cells, 0 for none
+    uint64_t *revealed_bits; // Per grid cell, rows padded like DirtyMap.bits: set once a trail head revealed it
+
+    uint8_t *fade; // Per grid cell, row-major or tiled like the grid: frames until its glyph darkens a shade, 0 if it stays as it is
+    uint8_t *fade_bucket; // Per grid cell, laid out like fade: speed bucket of the trail that drew it
+    uint8_t *tile_live; // Per tile of a tiled grid: listed in its band's tiles
+
+    /* Shades follow the distance behind the head, so each speed bucket has
+     * its own table: a slow trail's cell keeps a shade for more frames, and
+     * a fast one's skips shades it is past before the next frame.
+     */
+    uint8_t shade_frames[RAIN_SPEED_BUCKETS][PALETTE_MAX_SHADES + 1]; // How long a trail cell keeps each shade
+    uint8_t next_shade[RAIN_SPEED_BUCKETS][PALETTE_MAX_SHADES + 1];   // The shade after each one, 0 after the last
+
+    int load_level;    // See rain_set_load_level()
+    double spawn_density; // Settings.spawn_density
+    int spawn_rate;       // Hundredths of a random trail per frame over the whole width
+    int trail_density;    // Percent of spawn_rate that starts trails
+    int spawn_credit;     // Accumulates spawn_rate * trail_density; a trail starts for every 10000
+    int shade_step;    // Trail cells use every shade_step-th shade after the head
+
+    Palette palette;
+    Grid grid;
+
+    /* Bit per column, laid out like a DirtyMap row. top_occupied is set
+     * while the column's top cell holds a glyph; it is brought up to date
+     * from the dirty map each frame, so only changed columns are looked at.
+     * spawnable is where a trail may start this frame.
+     */
+    uint64_t *top_occupied;
+    uint64_t *spawnable;
+
+    TrailPool trails;
+
+    /* Every trail belongs to one speed bucket, whose trails all move the
+     * same number of rows each frame. A trail's head position is its
+     * head_row plus the bucket's phase, the fraction of a row the bucket has
+     * gone since its trails last moved; a frame adds the bucket's speed to
+     * it and moves them by the whole rows that makes. So a bucket of slow
+     * trails costs nothing on the frames where it doesn't reach a row.
+     */
+    int speed_buckets; // In use: 1 when min_speed and max_speed are the same
+    uint32_t bucket_speed[RAIN_SPEED_BUCKETS]; // Rows per frame, fixed point
+    uint32_t bucket_phase[RAIN_SPEED_BUCKETS]; // Below one row, fixed point
+    int bucket_steps[RAIN_SPEED_BUCKETS];      // Rows the bucket moves this frame
+
+    /* Flicker: every cell of a trail's body, behind the head, takes a new
+     * glyph with chance flicker_rate each frame. The bands pick those cells
+     * by drawing the gap to the next one from a geometric distribution and
+     * stepping over the trails' bodies by that much, so no number is drawn
+     * for the cells left alone. flicker_budget caps the changes per frame.
+     */
+    double flicker_scale; // 1 / ln(1 - flicker_rate), 0 for no flicker
+    int flicker_budget;
+
+    Rng rng; // Spawn columns and band seeds; see Settings.seed
+
+    int frame_counter;
+    int last_message_spawn_frame;
+
+    DirtyMap dirty;         // Cells written since the last diff
+    uint32_t *new_reveals;  // Message cells revealed this frame, drawn by rain_overlay_message()
+    size_t new_reveal_count;
+    size_t cells_drawn;     // Cells given a glyph this frame, whether or not they changed
+    size_t cells_erased;    // Cells blanked this frame
+    size_t spawn_attempts;  // Columns tried for a new trail this frame
+    size_t spawns;          // Trails started this frame
+
+    RainBand *bands;
+    int band_count;
+    int band_cols;       // Columns per band, a multiple of RAIN_BAND_ALIGN
+    WorkerPool workers;  // One thread per band at most; the caller is one of them
+
+    void (*update_trails)(struct Rain *rain, RainBand *band); // Narrow-only or width-aware, chosen in rain_init()
+} Rain;
+
+/* With settings->threads above one, trail updates run on that many threads,
+ * each taking a band of columns; the Rain must then stay where it is in memory.
+ * With a canvas in the settings the grid is tiled (see GRID_TILED): decay
+ * only visits the tiles in use, and tiles that went blank are given back.
+ */
+RainStatus rain_init(Rain *rain, const Settings *settings, int width, int height);
+void rain_free(Rain *rain);
+
+/* Memory the cells take: the grid and fade bytes, of the tiles in use only on a tiled grid. */
+size_t rain_grid_bytes(const Rain *rain);
+
+/* Adapt to a new terminal size without losing the animation: the grid keeps
+ * its overlapping part, trails outside it are retired, the message is
+ * centered again (clipped if it no longer fits) and every cell is marked
+ * dirty for a full redraw onto a cleared screen.
+ */
+RainStatus rain_resize(Rain *rain, int width, int height);
+/* Pick up edited settings between frames. Only message_spawn_frame_interval,
+ * max_trail_length, spawn_density, min_speed / max_speed (trails keep their
+ * bucket, which takes the new speed), flicker_rate, flicker_budget and
+ * message are followed, and the trail pool and message
+ * layout are rebuilt only when their value changed. A new message starts
+ * out hidden and is clipped rather than refused when it does not fit.
+ */
+RainStatus rain_apply_settings(Rain *rain, const Settings *settings);
+const char *rain_strerror(RainStatus status);
+
+/* The cell in the middle of the message's bounding box, for a view to
+ * follow; false when none of the message is on the grid.
+ */
+bool rain_message_center(const Rain *rain, int *row, int *col);
+
+/* Do less when the output can't keep up. Level 0 is full detail; each one
+ * above starts fewer random trails and skips more shades of the
+ * fade, so fewer cells change per frame. Trails already falling finish as
+ * they are.
+ */
+void rain_set_load_level(Rain *rain, int level);
+
+/* A frame is rain_begin_frame() followed by the four phases in this order.
+ * rain_step() runs all of them; they are exposed separately so the bench
+ * can time each phase on its own. Afterwards the grid holds the new frame
+ * and `dirty` bounds what changed; see front_buffer_diff().
+ */
+void rain_begin_frame(Rain *rain);
+
+/* Count every trail cell's fade byte down and darken the glyphs whose count
+ * ran out: one linear sweep in place of recoloring along each trail.
+ */
+void rain_decay(Rain *rain);
+void rain_update_trails(Rain *rain);
+void rain_overlay_message(Rain *rain);
+void rain_spawn_trails(Rain *rain);
+void rain_step(Rain *rain);
+
+/* A cell for the probes below. */
+typedef struct
+{
+    int row;
+    int col;
+    uint16_t glyph;
+} RainProbeCell;
+
+/* The per-cell primitives of a trail update, run over count cells as band 0
+ * would run them, for the microbenchmarks to time on their own. Each returns
+ * a count that depends on every call, so none is optimized away.
+ */
+size_t rain_probe_draw(Rain *rain, const RainProbeCell *cells, size_t count);
+size_t rain_probe_erase(Rain *rain, const RainProbeCell *cells, size_t count);
+size_t rain_probe_would_overwrite(const Rain *rain, const RainProbeCell *cells, size_t count);
+size_t rain_probe_random_symbols(Rain *rain, size_t count);
+
+#endif // !RAIN_H
@@ -0,0 +1,79 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "damage.h"
+#include "palette.h"
+#include "render.h"
+
+/* A recording is the header below, the palette as code points, then one
+ * record per frame or resize. Every part is a multiple of 8 bytes and in
+ * host byte order, so a frame's DrawOps can be presented straight from the
+ * mapped file.
+ */
+#define RECORDING_MAGIC 0x4352584du // "MXRC"
+#define RECORDING_VERSION 2
+#define RECORDING_BYTE_ORDER 0x01020304u
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t width;
+    uint32_t height;
+    uint32_t period_ms;
+    uint32_t symbol_count; // Palette entries, GLYPH_EMPTY included
+    uint32_t rain_count;
+    uint32_t color_mode; // ColorMode; the shades follow from it
+    uint32_t reserved;
+} RecordingHeader;
+
+typedef enum
+{
+    RECORD_FRAME = 1, // count DrawOps follow
+    RECORD_RESIZE,    // The screen was cleared; a RecordingSize follows
+    RECORD_PALETTE    // count code points follow, padded to 8 bytes, appended to the palette
+} RecordKind;
+
+typedef struct
+{
+    uint32_t kind;
+    uint32_t count;
+} RecordHeader;
+
+typedef struct
+{
+    uint32_t width;
+    uint32_t height;
+} RecordingSize;
+
+typedef struct
+{
+    FILE *file;
+    size_t frames;
+} Recorder;
+
+int recorder_open(Recorder *recorder, const char *path, int width, int height, int period_ms,
+                  const Palette *palette);
+
+/* Append a frame's diff; the writes are buffered, so this is a copy. */
+int recorder_frame(Recorder *recorder, const DrawList *list);
+int recorder_resize(Recorder *recorder, int width, int height);
+
+/* The palette grew (see palette_extend()); store the entries from index first on. */
+int recorder_palette(Recorder *recorder, const Palette *palette, size_t first);
+int recorder_close(Recorder *recorder);
+
+/* Play path back on the renderer, one frame every period_ms, or at the
+ * recorded rate when period_ms is 0, until it ends or *stop is set.
+ */
+int playback_run(const char *path, const Renderer *renderer, int period_ms, const volatile sig_atomic_t *stop);
+
+/* Convert path to an asciicast v2 file that asciinema and friends can play. */
+int playback_export_cast(const char *path, const char *cast_path, int period_ms);
+
+#endif // !RECORDING_H
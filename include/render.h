@@ -0,0 +1,63 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdbool.h>
+
+#include "damage.h"
+#include "rain.h"
+
+/* An output backend. Each replays the writes of a frame diff onto the
+ * terminal behind fd.
+ */
+typedef struct
+{
+    const char *name;
+
+    /* Renders to a file rather than a terminal someone is watching: frames
+     * are produced as fast as they can be, not at the refresh rate.
+     */
+    bool offscreen;
+
+    /* Take over the terminal. Positive *width / *height override the size
+     * the terminal reports; on return they hold the size in use.
+     */
+    int (*init)(int fd, int *width, int *height);
+    void (*present)(const DrawList *list, const Palette *palette);
+
+    /* The terminal changed size: pick up the new size into *width / *height
+     * and clear the screen, which the caller redraws from scratch.
+     */
+    int (*resize)(int *width, int *height);
+    void (*shutdown)(void);
+
+    /* Bytes sent to the terminal since init(). Safe to call while another
+     * thread presents. NULL when the backend can't tell, in which case
+     * output_budget can't be held to.
+     */
+    size_t (*bytes_written)(void);
+
+    /* Whether a present() since the last call dropped its frame, leaving the
+     * terminal behind the front copy; the caller then resends every row.
+     * Safe to call while another thread presents. NULL when no frame is ever
+     * dropped.
+     */
+    bool (*frame_lost)(void);
+} Renderer;
+
+extern const Renderer ncurses_renderer;
+extern const Renderer ansi_renderer;
+extern const Renderer null_renderer;
+
+/* Offscreen pixel backends: a stream of PPM images, or a Y4M (YUV 4:2:0)
+ * video, of 12x20 pixels per cell; 1920x1080 when no size is given.
+ */
+extern const Renderer ppm_renderer;
+extern const Renderer y4m_renderer;
+
+/* Frame rate the Y4M stream header announces; call before init(). */
+void video_set_frame_period(int period_ms);
+
+/* Look a backend up by name, NULL when there is none. */
+const Renderer *renderer_find(const char *name);
+
+#endif // !RENDER_H
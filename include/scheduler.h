@@ -0,0 +1,55 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Most steps a late frame runs to catch up; further behind, the schedule restarts
+#define SCHEDULER_MAX_CATCH_UP 4
+
+typedef enum
+{
+    FRAME_SKIP = 0, // Drop the steps of missed deadlines; the animation slows down
+    FRAME_CATCH_UP  // Run them before the next present; the animation keeps time
+} FramePolicy;
+
+/* Paces frames to absolute deadlines one period apart, so time spent on a
+ * frame does not push the following ones back and the rate does not drift.
+ */
+typedef struct
+{
+    int64_t period_ns;
+    FramePolicy policy;
+    int64_t deadline_ns; // CLOCK_MONOTONIC time the next frame is due
+
+    uint64_t frames;         // Deadlines slept to
+    uint64_t missed;         // Deadlines already past when the frame was done
+    uint64_t dropped;        // Steps of missed deadlines that never ran
+    int64_t jitter_total_ns; // Sum over frames of how late the sleep returned
+    int64_t jitter_max_ns;
+} FrameScheduler;
+
+void scheduler_init(FrameScheduler *scheduler, int period_ms, FramePolicy policy);
+
+/* Takes effect after the frame already scheduled. */
+void scheduler_set_period(FrameScheduler *scheduler, int period_ms);
+
+/* Sleep until the next frame is due. Returns how many simulation steps that
+ * frame runs: 1, more when catching up on missed deadlines, or 0 when a
+ * signal cut the sleep short (the deadline stands; call again).
+ */
+int scheduler_wait(FrameScheduler *scheduler);
+
+/* The same for callers that do their own waiting (see EventLoop): check
+ * scheduler_overran() once the frame is done, wait for deadline_ns, then
+ * scheduler_take() says how many steps the next frame runs.
+ */
+bool scheduler_overran(const FrameScheduler *scheduler);
+int scheduler_take(FrameScheduler *scheduler, bool overran);
+
+/* Start over one period from now, e.g. after a pause, without counting the
+ * gap as missed deadlines.
+ */
+void scheduler_restart(FrameScheduler *scheduler);
+
+#endif // !SCHEDULER_H
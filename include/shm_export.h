@@ -0,0 +1,92 @@
+#ifndef SHM_EXPORT_H
+#define SHM_EXPORT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "grid.h"
+#include "palette.h"
+
+#define SHM_EXPORT_MAGIC 0x4853584du // "MXSH"
+#define SHM_EXPORT_VERSION 1
+
+// Frames the ring holds; a reader has this many frame periods to copy one out
+#define SHM_EXPORT_SLOTS 4
+
+// Palette entries published; glyphs past this many are not resolvable by readers
+#define SHM_EXPORT_MAX_SYMBOLS 4096
+
+/* The start of the shared memory object. Everything is in host byte order
+ * and a reader maps the object read-only: nothing in it is ever waited on,
+ * so the animation never blocks on a reader, however slow.
+ *
+ * To take a frame, a reader:
+ *   1. loads geometry; while it is odd the slots are being moved, try again;
+ *   2. remaps when map_bytes grew past its mapping;
+ *   3. loads frame and finds that frame's slot, frame % slot_count, at
+ *      slot_offset + index * slot_bytes;
+ *   4. loads the slot's sequence (acquire); odd means it is being written;
+ *   5. copies the slot out, issues an acquire fence and loads sequence and
+ *      geometry again; if either changed, or the slot's frame is not the
+ *      one it went for, the copy is no good and it starts over.
+ * Falling behind by up to SHM_EXPORT_SLOTS frames only costs the frames in
+ * between.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t max_symbols;
+    uint64_t slot_offset;         // Of the first slot, from the start of the object
+    _Atomic uint64_t geometry;    // Odd while the slots are resized
+    _Atomic uint64_t slot_bytes;  // From one slot to the next
+    _Atomic uint64_t map_bytes;   // Size of the object; it only grows
+    _Atomic uint64_t frame;       // Last frame published, counting from 1; 0 before the first
+    _Atomic uint32_t symbol_count; // Entries of symbols in use; they are only ever appended
+    uint32_t color_mode;          // ColorMode
+    uint32_t shade_count;
+    uint8_t shade_rgb[PALETTE_MAX_SHADES + 1][3]; // What each shade in a color byte looks like
+    uint8_t reserved[5];
+    uint32_t symbols[SHM_EXPORT_MAX_SYMBOLS]; // Code point of each palette index; 0 is the blank cell
+} ShmExportHeader;
+
+/* A slot header, followed by the frame's Grid block as is: the glyph plane
+ * (width * height palette indices) and then the color plane (a byte per
+ * cell, shade and CELL_ flags), both laid out as layout says.
+ */
+typedef struct
+{
+    _Atomic uint64_t sequence; // Odd while the writer fills the slot
+    uint64_t frame;            // Which frame it holds, 0 for none
+    uint32_t width;
+    uint32_t height;
+    uint32_t layout; // GridLayout
+    uint32_t reserved;
+} ShmExportSlot;
+
+typedef struct
+{
+    char name[64];
+    int fd;
+    ShmExportHeader *header;
+    size_t map_bytes;
+    size_t slot_bytes;
+    uint64_t frame;
+} ShmExport;
+
+/* Create the shared memory object name ("/something") for grid's size,
+ * replacing one left over by an earlier run.
+ */
+int shm_export_open(ShmExport *shm, const char *name, const Grid *grid, const Palette *palette);
+
+/* Publish the grid as the next frame, straight from its block into a slot,
+ * along with palette entries added since the last frame. The slots grow
+ * when the grid no longer fits them.
+ */
+int shm_export_frame(ShmExport *shm, const Grid *grid, const Palette *palette);
+
+/* Unmap and remove the object; readers that have it mapped keep their view. */
+void shm_export_close(ShmExport *shm);
+
+#endif // !SHM_EXPORT_H
@@ -0,0 +1,51 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "render.h"
+
+// Output is judged over windows this long
+#define THROTTLE_WINDOW_NS 250000000LL
+
+// Windows in a row without backpressure before one load level is given back
+#define THROTTLE_CALM_WINDOWS 8
+
+// Bytes waiting in the terminal's output queue that count as backpressure when there is no budget
+#define THROTTLE_QUEUE_LIMIT 4096
+
+/* Picks a load level for the Rain (see rain_set_load_level()) from how the
+ * terminal keeps up: the share of time the output call blocks, the bytes
+ * still queued in the tty driver and, with a budget, the bytes per second
+ * sent. Any of them over its limit for a window sheds a level; detail comes
+ * back one level at a time after THROTTLE_CALM_WINDOWS quiet windows, and
+ * only while the rate stays well under the budget.
+ */
+typedef struct
+{
+    int fd;             // Terminal the output goes to
+    int64_t budget;     // Bytes per second the output may use, 0 for no limit
+    int level;
+
+    int64_t output_start_ns;
+    int64_t window_start_ns;
+    int64_t blocked_ns;   // Spent in the output call this window
+    size_t window_bytes;  // Renderer's byte count when the window began
+    int calm_windows;
+} Throttle;
+
+/* Start judging from now: the renderer's byte count so far belongs to no window. */
+void throttle_init(Throttle *throttle, int fd, int budget, const Renderer *renderer);
+
+/* Bracket the call that presents a frame, or hands it to the render thread. */
+void throttle_begin_output(Throttle *throttle);
+void throttle_end_output(Throttle *throttle);
+
+/* Once per frame: the load level the Rain should run at. Without a byte
+ * count from the renderer only blocking and the queue are watched.
+ */
+int throttle_update(Throttle *throttle, const Renderer *renderer);
+
+#endif // !THROTTLE_H
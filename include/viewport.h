@@ -0,0 +1,62 @@
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+#include <stdbool.h>
+
+#include "grid.h"
+#include "ini_parser.h"
+
+typedef enum
+{
+    VIEWPORT_FIXED = 0, // Stays at viewport_x, viewport_y
+    VIEWPORT_PAN,       // Sweeps across the canvas and back, pan_speed columns a frame
+    VIEWPORT_FOLLOW     // Glides over to the message and keeps it in the middle
+} ViewportMode;
+
+/* The part of a canvas bigger than the terminal that the terminal shows.
+ * The rain runs over the whole canvas; the view copies out the canvas cells
+ * under it that changed, into a grid of the terminal's size that the front
+ * buffer is diffed against, so cells outside it are simulated but never
+ * rendered.
+ */
+typedef struct
+{
+    Grid grid;      // What the terminal shows, in the settings' grid_layout
+    DirtyMap dirty; // Cells of grid changed since the last diff
+    int canvas_width;
+    int canvas_height;
+    int x; // Canvas cell at the top left of the view
+    int y;
+
+    ViewportMode mode;
+    int start_x; // viewport_x and viewport_y, to tell when they are edited
+    int start_y;
+    double pan_speed;
+    double pan_x;      // Where a panning view is, between columns
+    int pan_direction; // 1 to the right, -1 to the left
+    bool moved;        // The next sync copies every cell, not just the changed ones
+} Viewport;
+
+/* A width by height view of a canvas_width by canvas_height canvas. */
+int viewport_init(Viewport *vp, const Settings *settings, int width, int height, int canvas_width,
+                  int canvas_height);
+void viewport_free(Viewport *vp);
+
+/* Match a new terminal size; the canvas stays as it is. */
+int viewport_resize(Viewport *vp, int width, int height);
+
+/* Pick up edited viewport, viewport_x, viewport_y and pan_speed settings. */
+void viewport_apply_settings(Viewport *vp, const Settings *settings);
+
+/* Move the view on by steps frames. A following view heads for
+ * focus_row, focus_col, the canvas cell it should end up centered on.
+ */
+void viewport_move(Viewport *vp, int steps, int focus_row, int focus_col);
+
+/* Copy into the view what changed on the canvas under it, everything after
+ * a move, marking it in the view's dirty map; then clear canvas_dirty, as a
+ * diff of the canvas would have.
+ */
+void viewport_sync(Viewport *vp, const Grid *canvas, DirtyMap *canvas_dirty);
+
+#endif // !VIEWPORT_H
@@ -0,0 +1,26 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <time.h>
+
+/* Notices when a file has been rewritten. On Linux inotify watches the
+ * directory, so editors that save by renaming a new file over the old one
+ * are caught as well; elsewhere the modification time is compared.
+ */
+typedef struct
+{
+    int fd; // inotify descriptor, -1 without inotify
+    char path[PATH_MAX];
+    const char *name; // File name within path
+    struct timespec mtime;
+} FileWatch;
+
+int file_watch_init(FileWatch *watch, const char *path);
+void file_watch_free(FileWatch *watch);
+
+/* True once per batch of completed writes since the last call. Never blocks. */
+bool file_watch_changed(FileWatch *watch);
+
+#endif // !WATCH_H
@@ -0,0 +1,38 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef void (*WorkerTask)(void *ctx, int index, int count);
+
+typedef struct WorkerThread WorkerThread;
+
+/* A fixed set of threads that run one task together and wait for each
+ * other: the calling thread is worker 0, so a pool of one thread starts
+ * nothing and runs the task inline.
+ */
+typedef struct
+{
+    int count;
+    WorkerThread *threads; // count - 1 of them
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation; // Bumped for every task
+    int running;              // Helper threads still inside the current task
+    bool stop;
+
+    WorkerTask task;
+    void *ctx;
+} WorkerPool;
+
+int worker_pool_init(WorkerPool *pool, int count);
+void worker_pool_free(WorkerPool *pool);
+
+/* Call task(ctx, i, count) once for every worker i, concurrently, and return
+ * when all calls have returned.
+ */
+void worker_pool_run(WorkerPool *pool, WorkerTask task, void *ctx);
+
+#endif // !WORKERS_H
@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ansi.h"
+
+#define CSI "\x1b["
+
+// Worst case for one op: a full cursor position, a truecolor SGR and the glyph bytes
+#define OP_MAX_BYTES (16 + 24 + GLYPH_MAX_ENCODED)
+
+static int reserve(AnsiBuffer *buf, size_t extra)
+{
+    if (buf->len + extra <= buf->capacity)
+        return 0;
+
+    size_t capacity = buf->capacity ? buf->capacity : 4096;
+    while (capacity < buf->len + extra)
+        capacity *= 2;
+
+    char *data = realloc(buf->data, capacity);
+    if (!data)
+        return -1;
+    buf->data = data;
+    buf->capacity = capacity;
+    return 0;
+}
+
+static int digits(int n)
+{
+    int d = 1;
+    while (n >= 10)
+    {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static char *put_uint(char *p, int n)
+{
+    char tmp[12];
+    int len = 0;
+    do
+    {
+        tmp[len++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n);
+    while (len)
+        *p++ = tmp[--len];
+    return p;
+}
+
+/* CSI with an optional count (omitted when it is 1) and a final byte. */
+static char *put_csi(char *p, int n, char final)
+{
+    *p++ = '\x1b';
+    *p++ = '[';
+    if (n != 1)
+        p = put_uint(p, n);
+    *p++ = final;
+    return p;
+}
+
+static int csi_len(int n)
+{
+    return 3 + (n != 1 ? digits(n) : 0);
+}
+
+/* Append the shortest sequence that moves the cursor to row,col. Space is reserved by the caller. */
+static void move_cursor(AnsiBuffer *buf, int row, int col)
+{
+    const int cr = buf->cursor_row;
+    const int cc = buf->cursor_col;
+    if (cr == row && cc == col)
+        return;
+
+    char *p = buf->data + buf->len;
+
+    // Absolute position is always available
+    int best = row == 0 && col == 0 ? 3 : 4 + digits(row + 1) + digits(col + 1);
+    char kind = 'H';
+
+    if (cr == row)
+    {
+        if (col == 0 && 1 < best)
+        {
+            best = 1;
+            kind = '\r';
+        }
+        if (col > cc && csi_len(col - cc) < best)
+        {
+            best = csi_len(col - cc);
+            kind = 'C';
+        }
+        if (cc >= 0 && col < cc && csi_len(cc - col) < best)
+        {
+            best = csi_len(cc - col);
+            kind = 'D';
+        }
+        if (csi_len(col + 1) < best)
+        {
+            best = csi_len(col + 1);
+            kind = 'G';
+        }
+    }
+    else if (cr >= 0 && cc == col)
+    {
+        if (row > cr && csi_len(row - cr) < best)
+        {
+            best = csi_len(row - cr);
+            kind = 'B';
+        }
+        if (row < cr && csi_len(cr - row) < best)
+        {
+            best = csi_len(cr - row);
+            kind = 'A';
+        }
+    }
+    else if (cr >= 0 && row == cr + 1 && col == 0 && 2 < best)
+    {
+        best = 2;
+        kind = '\n';
+    }
+
+    switch (kind)
+    {
+    case '\r':
+        *p++ = '\r';
+        break;
+    case '\n':
+        *p++ = '\r';
+        *p++ = '\n';
+        break;
+    case 'C':
+        p = put_csi(p, col - cc, 'C');
+        break;
+    case 'D':
+        p = put_csi(p, cc - col, 'D');
+        break;
+    case 'G':
+        p = put_csi(p, col + 1, 'G');
+        break;
+    case 'B':
+        p = put_csi(p, row - cr, 'B');
+        break;
+    case 'A':
+        p = put_csi(p, cr - row, 'A');
+        break;
+    default:
+        *p++ = '\x1b';
+        *p++ = '[';
+        if (row != 0 || col != 0)
+        {
+            p = put_uint(p, row + 1);
+            *p++ = ';';
+            p = put_uint(p, col + 1);
+        }
+        *p++ = 'H';
+        break;
+    }
+
+    buf->len = p - buf->data;
+    buf->cursor_row = row;
+    buf->cursor_col = col;
+}
+
+/* Append the SGR that selects shade as the foreground: 38;5 with a 256-color
+ * palette, 24-bit otherwise, which for COLORS_BASIC matches the init_color()
+ * values of the ncurses output. The background is set to black once when the
+ * terminal is taken over and never changes. Space is reserved by the caller.
+ */
+static void select_shade(AnsiBuffer *buf, const Palette *palette, int shade)
+{
+    char *p = buf->data + buf->len;
+    memcpy(p, CSI "38;", 5);
+    p += 5;
+    if (palette->color_mode == COLORS_256)
+    {
+        *p++ = '5';
+        *p++ = ';';
+        p = put_uint(p, palette->shade_xterm[shade]);
+    }
+    else
+    {
+        *p++ = '2';
+        for (int c = 0; c < 3; c++)
+        {
+            *p++ = ';';
+            p = put_uint(p, palette->shade_rgb[shade][c]);
+        }
+    }
+    *p++ = 'm';
+    buf->len = p - buf->data;
+}
+
+int ansi_buffer_init(AnsiBuffer *buf, int width)
+{
+    *buf = (AnsiBuffer){0};
+    buf->width = width;
+    ansi_invalidate(buf);
+    return reserve(buf, 4096);
+}
+
+void ansi_buffer_free(AnsiBuffer *buf)
+{
+    free(buf->data);
+    *buf = (AnsiBuffer){0};
+}
+
+void ansi_begin_frame(AnsiBuffer *buf)
+{
+    buf->len = 0;
+}
+
+void ansi_invalidate(AnsiBuffer *buf)
+{
+    buf->cursor_row = -1;
+    buf->cursor_col = -1;
+    buf->color = -1;
+}
+
+int ansi_append(AnsiBuffer *buf, const char *bytes, size_t len)
+{
+    if (reserve(buf, len) != 0)
+        return -1;
+    memcpy(buf->data + buf->len, bytes, len);
+    buf->len += len;
+    return 0;
+}
+
+int ansi_encode(AnsiBuffer *buf, const DrawList *list, const Palette *palette)
+{
+    if (reserve(buf, list->count * OP_MAX_BYTES) != 0)
+        return -1;
+
+    for (size_t i = 0; i < list->count; i++)
+    {
+        const DrawOp *op = &list->ops[i];
+
+        move_cursor(buf, op->row, op->col);
+
+        // Blanks only show the background, so they keep whatever color is selected
+        if (op->color_pair != 0 && op->color_pair != buf->color)
+        {
+            select_shade(buf, palette, op->color_pair);
+            buf->color = op->color_pair;
+        }
+
+        if (op->glyph == GLYPH_EMPTY)
+        {
+            memset(buf->data + buf->len, ' ', op->cells);
+            buf->len += op->cells;
+        }
+        else
+        {
+            memcpy(buf->data + buf->len, palette->encoded[op->glyph], palette->encoded_len[op->glyph]);
+            buf->len += palette->encoded_len[op->glyph];
+        }
+
+        buf->cursor_col += op->cells;
+        if (buf->cursor_col >= buf->width)
+        {
+            // Terminals differ on the pending-wrap state after the last column
+            buf->cursor_row = -1;
+            buf->cursor_col = -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "rain.h"
+#include "damage.h"
+#include "scheduler.h"
+#include "pipeline.h"
+#include "recording.h"
+
+typedef enum
+{
+    PHASE_DECAY,
+    PHASE_TRAILS,
+    PHASE_SPAWN,
+    PHASE_MESSAGE,
+    PHASE_DIFF,
+    PHASE_RECORD,
+    PHASE_OUTPUT,
+    PHASE_COUNT
+} BenchPhase;
+
+static const char *phase_names[PHASE_COUNT] = {
+    "decay",
+    "trail update",
+    "spawning",
+    "message overlay",
+    "diff",
+    "recording",
+    "output",
+};
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* FNV-1a over the glyph plane, so runs with the same seed can be compared. */
+static unsigned long grid_checksum(const Grid *grid)
+{
+    unsigned long hash = 2166136261u;
+    for (int row = 0; row < grid->height; row++)
+    {
+        for (int col = 0; col < grid->width; col++)
+        {
+            hash ^= grid->glyph[grid_index(grid, row, col)];
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+int bench_run(const Settings *settings, const BenchOptions *options, const Renderer *renderer)
+{
+    FILE *sink = tmpfile();
+    if (!sink)
+    {
+        perror("tmpfile");
+        return 1;
+    }
+
+    int width = options->width;
+    int height = options->height;
+    video_set_frame_period(settings->refresh_rate);
+    if (renderer->init(fileno(sink), &width, &height) != 0)
+    {
+        fclose(sink);
+        return 1;
+    }
+
+    Rain rain;
+    RainStatus status = rain_init(&rain, settings, width, height);
+    if (status != RAIN_OK)
+    {
+        renderer->shutdown();
+        fclose(sink);
+        fprintf(stderr, "Error: %s\n", rain_strerror(status));
+        return 1;
+    }
+
+    FrontBuffer front;
+    double *frame_ns = malloc(options->frames * sizeof(double));
+    if (!frame_ns || front_buffer_init(&front, width, height, rain.grid.layout) != 0)
+    {
+        free(frame_ns);
+        renderer->shutdown();
+        fclose(sink);
+        rain_free(&rain);
+        fprintf(stderr, "Error: %s\n", rain_strerror(RAIN_ERR_ALLOC));
+        return 1;
+    }
+
+    RenderPipeline pipeline;
+    const bool pipelined = settings->threads > 1;
+    if (pipelined && render_pipeline_start(&pipeline, renderer, &rain.palette) != 0)
+    {
+        free(frame_ns);
+        front_buffer_free(&front);
+        renderer->shutdown();
+        fclose(sink);
+        rain_free(&rain);
+        fprintf(stderr, "Error: can't start the render thread\n");
+        return 1;
+    }
+
+    double phase_ns[PHASE_COUNT] = {0};
+    size_t cells_drawn = 0;
+    size_t cells_erased = 0;
+    size_t spawn_attempts = 0;
+    size_t spawns = 0;
+    size_t cells_changed = 0;
+
+    Recorder recorder;
+    if (options->record &&
+        recorder_open(&recorder, options->record, width, height, settings->refresh_rate, &rain.palette) != 0)
+    {
+        perror(options->record);
+        if (pipelined)
+            render_pipeline_stop(&pipeline);
+        free(frame_ns);
+        front_buffer_free(&front);
+        renderer->shutdown();
+        fclose(sink);
+        rain_free(&rain);
+        return 1;
+    }
+
+    FrameScheduler scheduler;
+    scheduler_init(&scheduler, settings->refresh_rate, settings->frame_policy);
+
+    int exit_status = 0;
+    const double start = now_ns();
+    for (long f = 0; f < options->frames; f++)
+    {
+        if (options->paced)
+        {
+            int steps;
+            while ((steps = scheduler_wait(&scheduler)) == 0)
+                ;
+            // Catch-up steps are simulated but not timed
+            for (int s = 1; s < steps; s++)
+                rain_step(&rain);
+        }
+
+        const double t0 = now_ns();
+        rain_begin_frame(&rain);
+        rain_decay(&rain);
+        const double td = now_ns();
+        rain_update_trails(&rain);
+        const double t1 = now_ns();
+        rain_overlay_message(&rain);
+        const double t2 = now_ns();
+        rain_spawn_trails(&rain);
+        const double t3 = now_ns();
+        if (front_buffer_diff(&front, &rain.grid, &rain.dirty) != 0)
+        {
+            exit_status = 1;
+            break;
+        }
+        const double t4 = now_ns();
+        if (options->record)
+            recorder_frame(&recorder, &front.list);
+        const double t5 = now_ns();
+        if (pipelined)
+            render_pipeline_submit(&pipeline, &front.list); // Output time is then the wait for the previous frame
+        else
+            renderer->present(&front.list, &rain.palette);
+        const double t6 = now_ns();
+
+        phase_ns[PHASE_DECAY] += td - t0;
+        phase_ns[PHASE_TRAILS] += t1 - td;
+        phase_ns[PHASE_MESSAGE] += t2 - t1;
+        phase_ns[PHASE_SPAWN] += t3 - t2;
+        phase_ns[PHASE_DIFF] += t4 - t3;
+        phase_ns[PHASE_RECORD] += t5 - t4;
+        phase_ns[PHASE_OUTPUT] += t6 - t5;
+        frame_ns[f] = t6 - t0;
+
+        cells_drawn += rain.cells_drawn;
+        cells_erased += rain.cells_erased;
+        spawn_attempts += rain.spawn_attempts;
+        spawns += rain.spawns;
+        cells_changed += front.cells_changed;
+    }
+    if (pipelined)
+        render_pipeline_stop(&pipeline);
+    if (options->record)
+        recorder_close(&recorder);
+    const double elapsed = now_ns() - start;
+
+    renderer->shutdown();
+    const long bytes = lseek(fileno(sink), 0, SEEK_END);
+    fclose(sink);
+    if (exit_status)
+    {
+        fprintf(stderr, "Error: %s\n", rain_strerror(RAIN_ERR_ALLOC));
+        free(frame_ns);
+        front_buffer_free(&front);
+        rain_free(&rain);
+        return 1;
+    }
+
+    qsort(frame_ns, options->frames, sizeof(double), compare_double);
+    const double p50 = frame_ns[(options->frames - 1) * 50 / 100];
+    const double p99 = frame_ns[(options->frames - 1) * 99 / 100];
+
+    printf("bench: %dx%d, %ld frames, seed %llu, %s renderer, %d thread%s%s\n",
+           width, height, options->frames, (unsigned long long)settings->seed, renderer->name, rain.workers.count,
+           rain.workers.count == 1 ? "" : "s", pipelined ? " + output" : "");
+    printf("  frames/sec       %12.1f\n", options->frames / (elapsed / 1e9));
+    printf("  frame p50        %12.2f us\n", p50 / 1e3);
+    printf("  frame p99        %12.2f us\n", p99 / 1e3);
+    printf("  %-16s %12s %14s\n", "phase", "total ms", "us/frame");
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        if (p == PHASE_RECORD && !options->record)
+            continue;
+        printf("  %-16s %12.3f %14.3f\n", phase_names[p],
+               phase_ns[p] / 1e6, phase_ns[p] / 1e3 / options->frames);
+    }
+    printf("  cells drawn      %12zu (%.1f/frame)\n", cells_drawn, (double)cells_drawn / options->frames);
+    printf("  cells erased     %12zu (%.1f/frame)\n", cells_erased, (double)cells_erased / options->frames);
+    printf("  cells changed    %12zu (%.1f/frame)\n", cells_changed, (double)cells_changed / options->frames);
+    printf("  bytes written    %12ld (%.1f/frame)\n", bytes, (double)bytes / options->frames);
+    printf("  active trails    %12zu of %zu\n", rain.trails.active_count, rain.trails.capacity);
+    printf("  trails spawned   %12zu of %zu tries\n", spawns, spawn_attempts);
+    printf("  grid memory      %12zu bytes (%s)\n", rain_grid_bytes(&rain),
+           rain.grid.layout == GRID_TILED          ? "tiled, tiles in use"
+           : rain.grid.layout == GRID_COLUMN_MAJOR ? "column-major"
+                                                   : "row-major");
+    if (options->paced)
+    {
+        printf("  frame period     %12.3f ms (%s)\n", scheduler.period_ns / 1e6,
+               scheduler.policy == FRAME_CATCH_UP ? "catch_up" : "skip");
+        printf("  missed deadlines %12llu\n", (unsigned long long)scheduler.missed);
+        printf("  dropped steps    %12llu\n", (unsigned long long)scheduler.dropped);
+        printf("  jitter mean      %12.2f us\n",
+               scheduler.frames ? scheduler.jitter_total_ns / 1e3 / scheduler.frames : 0.0);
+        printf("  jitter max       %12.2f us\n", scheduler.jitter_max_ns / 1e3);
+    }
+    printf("  checksum         %12lx\n", grid_checksum(&rain.grid));
+
+    free(frame_ns);
+    front_buffer_free(&front);
+    rain_free(&rain);
+    return 0;
+}
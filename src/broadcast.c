@@ -0,0 +1,470 @@
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ansi.h"
+#include "broadcast.h"
+#include "damage.h"
+#include "metrics.h"
+#include "rain.h"
+#include "render.h"
+#include "scheduler.h"
+
+// Starts a keyframe: default colors on the black background, screen cleared
+#define KEYFRAME_SEQUENCE "\x1b[0;40m\x1b[2J"
+
+/* Encoded bytes shared by every client they are queued to; freed with the last reference. */
+typedef struct
+{
+    size_t refs;
+    size_t len;
+    char *data;
+} BroadcastFrame;
+
+typedef struct
+{
+    int fd;
+    BroadcastFrame *backlog[BROADCAST_MAX_BACKLOG]; // Oldest first
+    int queued;
+    size_t sent;        // Bytes of backlog[0] already sent
+    bool needs_keyframe;
+} Client;
+
+typedef struct
+{
+    int listen_fd;
+    const char *bound_path; // Unix socket this server bound and removes on exit; NULL over TCP
+    Client *clients;
+    int client_count;
+    int client_capacity;
+} Server;
+
+/* Write all of len, retrying on short writes and signals. */
+static int write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static BroadcastFrame *frame_ref(BroadcastFrame *frame)
+{
+    frame->refs++;
+    return frame;
+}
+
+static void frame_unref(BroadcastFrame *frame)
+{
+    if (frame && --frame->refs == 0)
+    {
+        free(frame->data);
+        free(frame);
+    }
+}
+
+/* Take the encoded bytes out of buf, which starts over with an empty buffer. */
+static BroadcastFrame *frame_take(AnsiBuffer *buf)
+{
+    BroadcastFrame *frame = malloc(sizeof(BroadcastFrame));
+    if (!frame)
+        return NULL;
+    *frame = (BroadcastFrame){1, buf->len, buf->data};
+    buf->data = NULL;
+    buf->len = 0;
+    buf->capacity = 0;
+    return frame;
+}
+
+static bool is_unix_address(const char *address)
+{
+    return strchr(address, '/') || !strchr(address, ':');
+}
+
+/* Split address into a Unix socket path or a TCP host and port. */
+static int parse_address(const char *address, struct sockaddr_un *unix_addr, char *host, size_t host_size,
+                         const char **port)
+{
+    const char *colon = strrchr(address, ':');
+    if (is_unix_address(address))
+    {
+        if (strlen(address) >= sizeof(unix_addr->sun_path))
+            return -1;
+        *unix_addr = (struct sockaddr_un){.sun_family = AF_UNIX};
+        strcpy(unix_addr->sun_path, address);
+        *port = NULL;
+        return 0;
+    }
+
+    if ((size_t)(colon - address) >= host_size)
+        return -1;
+    snprintf(host, host_size, "%.*s", (int)(colon - address), address);
+    *port = colon + 1;
+    return 0;
+}
+
+/* A socket listening on address, or connected to it; -1 on error. */
+static int open_socket(const char *address, bool listening)
+{
+    struct sockaddr_un unix_addr;
+    char host[256];
+    const char *port;
+    if (parse_address(address, &unix_addr, host, sizeof(host), &port) != 0)
+    {
+        fprintf(stderr, "Error: bad address '%s'\n", address);
+        return -1;
+    }
+
+    // The server polls for new clients once a frame
+    const int flags = SOCK_CLOEXEC | (listening ? SOCK_NONBLOCK : 0);
+
+    if (!port)
+    {
+        const int fd = socket(AF_UNIX, SOCK_STREAM | flags, 0);
+        if (fd < 0)
+            return -1;
+        if (listening)
+            unlink_stale_socket(unix_addr.sun_path);
+        const int status = listening ? bind(fd, (struct sockaddr *)&unix_addr, sizeof(unix_addr))
+                                     : connect(fd, (struct sockaddr *)&unix_addr, sizeof(unix_addr));
+        if (status != 0 || (listening && listen(fd, 16) != 0))
+        {
+            perror(address);
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = listening ? AI_PASSIVE : 0};
+    struct addrinfo *found;
+    const int err = getaddrinfo(host[0] ? host : NULL, port, &hints, &found);
+    if (err != 0)
+    {
+        fprintf(stderr, "Error: %s: %s\n", address, gai_strerror(err));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = found; ai; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype | flags, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        const int on = 1;
+        if (listening)
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        else
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        const int status = listening ? bind(fd, ai->ai_addr, ai->ai_addrlen) : connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (status == 0 && (!listening || listen(fd, 16) == 0))
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+    if (fd < 0)
+        perror(address);
+    return fd;
+}
+
+static void client_drop_backlog(Client *client)
+{
+    // A frame partly sent has to be finished, or the terminal is left inside an escape sequence
+    const int keep = client->sent > 0 ? 1 : 0;
+    for (int i = keep; i < client->queued; i++)
+        frame_unref(client->backlog[i]);
+    client->queued = keep;
+}
+
+static void client_close(Client *client)
+{
+    client->sent = 0;
+    client_drop_backlog(client);
+    close(client->fd);
+}
+
+static void accept_clients(Server *server)
+{
+    int fd;
+    while ((fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        if (server->client_count == server->client_capacity)
+        {
+            const int capacity = server->client_capacity ? server->client_capacity * 2 : 8;
+            Client *clients = realloc(server->clients, capacity * sizeof(Client));
+            if (!clients)
+            {
+                close(fd);
+                return;
+            }
+            server->clients = clients;
+            server->client_capacity = capacity;
+        }
+        const int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // Fails harmlessly on Unix sockets
+        server->clients[server->client_count++] = (Client){.fd = fd, .needs_keyframe = true};
+    }
+}
+
+/* Send as much of the client's backlog as the socket takes without
+ * blocking, straight out of the shared frames. -1 when the client is gone.
+ */
+static int client_flush(Client *client)
+{
+    while (client->queued > 0)
+    {
+        struct iovec iov[BROADCAST_MAX_BACKLOG];
+        for (int i = 0; i < client->queued; i++)
+            iov[i] = (struct iovec){client->backlog[i]->data, client->backlog[i]->len};
+        iov[0].iov_base = (char *)iov[0].iov_base + client->sent;
+        iov[0].iov_len -= client->sent;
+
+        const struct msghdr msg = {.msg_iov = iov, .msg_iovlen = client->queued};
+        ssize_t n = sendmsg(client->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+
+        // Retire the frames that went out whole
+        n += client->sent;
+        int done = 0;
+        while (done < client->queued && (size_t)n >= client->backlog[done]->len)
+        {
+            n -= client->backlog[done]->len;
+            frame_unref(client->backlog[done++]);
+        }
+        memmove(client->backlog, client->backlog + done, (client->queued - done) * sizeof(BroadcastFrame *));
+        client->queued -= done;
+        client->sent = n;
+        if (client->queued > 0)
+            return 0; // The socket is full
+    }
+    return 0;
+}
+
+/* The whole screen as the front buffer holds it, after a clear. */
+static BroadcastFrame *encode_keyframe(const FrontBuffer *front, const Palette *palette, DrawList *scratch,
+                                       AnsiBuffer *buf)
+{
+    const Grid *grid = &front->front;
+    scratch->count = 0;
+    if (draw_list_reserve(scratch, (size_t)grid->width * grid->height) != 0)
+        return NULL;
+
+    for (int row = 0; row < grid->height; row++)
+    {
+        for (int col = 0; col < grid->width; col++)
+        {
+            const size_t cell = grid_index(grid, row, col);
+            const uint8_t color = grid->color[cell];
+            if (grid->glyph[cell] == GLYPH_EMPTY || (color & CELL_CONT))
+                continue;
+            scratch->ops[scratch->count++] = (DrawOp){
+                row, col,
+                grid->glyph[cell],
+                (uint8_t)(color & CELL_COLOR_MASK),
+                (uint8_t)((color & CELL_WIDE) && col + 1 < grid->width ? 2 : 1),
+            };
+        }
+    }
+
+    ansi_begin_frame(buf);
+    ansi_invalidate(buf);
+    if (ansi_append(buf, KEYFRAME_SEQUENCE, strlen(KEYFRAME_SEQUENCE)) != 0 || ansi_encode(buf, scratch, palette) != 0)
+        return NULL;
+    return frame_take(buf);
+}
+
+/* Queue this frame to every client, a keyframe to those that need one, and send what fits. */
+static int broadcast_frame(Server *server, BroadcastFrame *delta, const FrontBuffer *front, const Palette *palette,
+                           DrawList *scratch, AnsiBuffer *buf)
+{
+    BroadcastFrame *keyframe = NULL;
+
+    for (int i = 0; i < server->client_count;)
+    {
+        Client *client = &server->clients[i];
+
+        if (client->queued == BROADCAST_MAX_BACKLOG)
+        {
+            // Too far behind: what it has not got yet is stale, a keyframe replaces it
+            client_drop_backlog(client);
+            client->needs_keyframe = true;
+        }
+
+        BroadcastFrame *frame = delta;
+        if (client->needs_keyframe)
+        {
+            if (!keyframe && !(keyframe = encode_keyframe(front, palette, scratch, buf)))
+                return -1;
+            frame = keyframe;
+            client->needs_keyframe = false;
+        }
+        if (frame->len > 0)
+            client->backlog[client->queued++] = frame_ref(frame);
+
+        if (client_flush(client) != 0)
+        {
+            client_close(client);
+            server->clients[i] = server->clients[--server->client_count];
+            continue;
+        }
+        i++;
+    }
+
+    frame_unref(keyframe);
+    return 0;
+}
+
+/* Stop listening, removing the socket file if it is the one this server bound. */
+static void close_listener(Server *server)
+{
+    close(server->listen_fd);
+    if (server->bound_path)
+        unlink(server->bound_path);
+    server->listen_fd = -1;
+}
+
+int broadcast_serve(const Settings *settings, const char *address, int width, int height,
+                    const volatile sig_atomic_t *stop)
+{
+    Server server = {.listen_fd = open_socket(address, true)};
+    if (server.listen_fd < 0)
+        return 1;
+    if (is_unix_address(address))
+        server.bound_path = address;
+
+    Rain rain;
+    RainStatus status = rain_init(&rain, settings, width, height);
+    if (status != RAIN_OK)
+    {
+        close_listener(&server);
+        fprintf(stderr, "Error: %s.\n", rain_strerror(status));
+        return 1;
+    }
+
+    FrontBuffer front;
+    AnsiBuffer buf;
+    DrawList scratch = {0};
+    if (front_buffer_init(&front, width, height, rain.grid.layout) != 0 || ansi_buffer_init(&buf, width) != 0)
+    {
+        close_listener(&server);
+        rain_free(&rain);
+        fprintf(stderr, "Error: %s.\n", rain_strerror(RAIN_ERR_ALLOC));
+        return 1;
+    }
+
+    printf("Serving %dx%d on %s\n", width, height, address);
+    fflush(stdout);
+
+    FrameScheduler scheduler;
+    scheduler_init(&scheduler, settings->refresh_rate, settings->frame_policy);
+
+    int exit_status = 0;
+    int steps = 1;
+    while (!*stop)
+    {
+        for (int i = 0; i < steps; i++)
+            rain_step(&rain);
+        if (front_buffer_diff(&front, &rain.grid, &rain.dirty) != 0)
+        {
+            exit_status = 1;
+            break;
+        }
+        accept_clients(&server);
+
+        // Every frame starts from an unknown cursor and color, so a keyframe can stand in for any of them
+        ansi_begin_frame(&buf);
+        ansi_invalidate(&buf);
+        BroadcastFrame *delta = ansi_encode(&buf, &front.list, &rain.palette) == 0 ? frame_take(&buf) : NULL;
+        if (!delta || broadcast_frame(&server, delta, &front, &rain.palette, &scratch, &buf) != 0)
+        {
+            frame_unref(delta);
+            exit_status = 1;
+            break;
+        }
+        frame_unref(delta);
+
+        steps = scheduler_wait(&scheduler);
+    }
+
+    for (int i = 0; i < server.client_count; i++)
+        client_close(&server.clients[i]);
+    free(server.clients);
+    close_listener(&server);
+
+    if (exit_status)
+        fprintf(stderr, "Error: %s.\n", rain_strerror(RAIN_ERR_ALLOC));
+    free(scratch.ops);
+    ansi_buffer_free(&buf);
+    front_buffer_free(&front);
+    rain_free(&rain);
+    return exit_status;
+}
+
+int broadcast_connect(const char *address, const volatile sig_atomic_t *stop)
+{
+    const int fd = open_socket(address, false);
+    if (fd < 0)
+        return 1;
+
+    // The ANSI backend sets the terminal up and restores it; the stream does the drawing
+    int width = 0, height = 0;
+    if (ansi_renderer.init(STDOUT_FILENO, &width, &height) != 0)
+    {
+        close(fd);
+        return 1;
+    }
+
+    char data[65536];
+    int exit_status = 0;
+    while (!*stop)
+    {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (poll(&pfd, 1, 100) <= 0)
+            continue; // Timeout or signal: check *stop
+
+        const ssize_t n = read(fd, data, sizeof(data));
+        if (n == 0)
+            break; // Server gone
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            exit_status = 1;
+            break;
+        }
+        if (write_all(STDOUT_FILENO, data, n) != 0)
+        {
+            exit_status = 1;
+            break;
+        }
+    }
+
+    ansi_renderer.shutdown();
+    close(fd);
+    return exit_status;
+}
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "damage.h"
+#include "palette.h"
+
+// Front copy of a cell whose screen contents are unknown; matches no glyph
+#define GLYPH_UNKNOWN 0xffff
+
+int draw_list_reserve(DrawList *list, size_t extra)
+{
+    if (list->count + extra <= list->capacity)
+        return 0;
+
+    size_t capacity = list->capacity ? list->capacity : 1024;
+    while (capacity < list->count + extra)
+        capacity *= 2;
+
+    DrawOp *ops = realloc(list->ops, capacity * sizeof(DrawOp));
+    if (!ops)
+        return -1;
+    list->ops = ops;
+    list->capacity = capacity;
+    return 0;
+}
+
+int front_buffer_init(FrontBuffer *fb, int width, int height, GridLayout layout)
+{
+    *fb = (FrontBuffer){0};
+    if (grid_init(&fb->front, width, height, layout) != 0)
+        return -1;
+    return draw_list_reserve(&fb->list, (size_t)width * 4);
+}
+
+void front_buffer_free(FrontBuffer *fb)
+{
+    grid_free(&fb->front);
+    free(fb->list.ops);
+    *fb = (FrontBuffer){0};
+}
+
+void front_buffer_reset(FrontBuffer *fb)
+{
+    memset(fb->front.glyph, 0, fb->front.cells * sizeof(uint16_t));
+    memset(fb->front.color, 0, fb->front.cells);
+}
+
+void front_buffer_invalidate_row(FrontBuffer *fb, int row)
+{
+    Grid *front = &fb->front;
+    for (int col = 0; col < front->width; col++)
+        front->glyph[grid_index(front, row, col)] = GLYPH_UNKNOWN;
+}
+
+int front_buffer_resize(FrontBuffer *fb, int width, int height)
+{
+    Grid front;
+    if (grid_init(&front, width, height, fb->front.layout) != 0)
+        return -1;
+
+    grid_free(&fb->front);
+    fb->front = front;
+    return draw_list_reserve(&fb->list, (size_t)width * 4);
+}
+
+/* Bring one cell (both halves of a wide glyph) up to date and record the
+ * write. Returns the number of columns handled.
+ */
+static int diff_cell(FrontBuffer *fb, const Grid *back, int row, int col)
+{
+    Grid *front = &fb->front;
+    const size_t cell = grid_index(back, row, col);
+    const uint16_t glyph = back->glyph[cell];
+    const uint8_t color = back->color[cell];
+
+    if (glyph == front->glyph[cell] && color == front->color[cell])
+        return 1;
+
+    front->glyph[cell] = glyph;
+    front->color[cell] = color;
+
+    // A trailing half goes out with its leading half, which is dirty as well
+    if (color & CELL_CONT)
+        return 1;
+
+    int cells = 1;
+    if ((color & CELL_WIDE) && col + 1 < back->width)
+    {
+        const size_t right = grid_index(back, row, col + 1);
+        front->glyph[right] = back->glyph[right];
+        front->color[right] = back->color[right];
+        cells = 2;
+    }
+
+    fb->list.ops[fb->list.count++] = (DrawOp){
+        row, col,
+        glyph,
+        glyph == GLYPH_EMPTY ? 0 : (uint8_t)(color & CELL_COLOR_MASK),
+        (uint8_t)cells,
+    };
+    fb->cells_changed += cells;
+    return cells;
+}
+
+/* The back grid never holds half a wide glyph (the simulation clears the other
+ * half when it overwrites one), so writing every changed cell left to right
+ * leaves the terminal matching it even where a write clobbers the neighbour
+ * of an old wide glyph: that neighbour differs too and is written as well.
+ */
+int front_buffer_diff(FrontBuffer *fb, const Grid *back, DirtyMap *dirty)
+{
+    fb->list.count = 0;
+    fb->cells_changed = 0;
+
+    for (int row = 0; row < back->height; row++)
+    {
+        DirtySpan *span = &dirty->spans[row];
+        if (span->lo >= span->hi)
+            continue;
+
+        if (draw_list_reserve(&fb->list, span->hi - span->lo) != 0)
+            return -1;
+
+        uint64_t *bits = dirty->bits + row * dirty->words_per_row;
+        const size_t first = span->lo / 64;
+        const size_t last = (span->hi - 1) / 64;
+        int next = 0; // First column not yet handled, so a wide write isn't repeated
+
+        for (size_t w = first; w <= last; w++)
+        {
+            uint64_t word = bits[w];
+            bits[w] = 0;
+            while (word)
+            {
+                const int col = (int)(w * 64) + __builtin_ctzll(word);
+                word &= word - 1;
+                if (col >= next)
+                    next = col + diff_cell(fb, back, row, col);
+            }
+        }
+
+        span->lo = back->width;
+        span->hi = 0;
+    }
+
+    return 0;
+}
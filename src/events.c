@@ -0,0 +1,267 @@
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#else
+#include <fcntl.h>
+#endif
+
+#include "events.h"
+
+#define NS_PER_SEC 1000000000LL
+
+static const int handled_signals[] = {SIGWINCH, SIGINT, SIGTERM};
+#define HANDLED_SIGNALS (int)(sizeof(handled_signals) / sizeof(handled_signals[0]))
+
+static void add_signal_event(Events *events, int sig)
+{
+    events->flags |= sig == SIGWINCH ? EVENT_RESIZE : EVENT_QUIT;
+}
+
+/* Read what was typed, handing the keys back; stop reading at end of file. */
+static void read_input(EventLoop *loop, Events *events)
+{
+    const ssize_t n = read(loop->input_fd, events->keys + events->key_count,
+                           EVENT_LOOP_MAX_KEYS - events->key_count);
+    if (n > 0)
+    {
+        events->key_count += (int)n;
+        return;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EINTR))
+    {
+#ifdef __linux__
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, loop->input_fd, NULL);
+#endif
+        loop->input_fd = -1; // A closed or redirected stdin: no keys, keep running
+    }
+}
+
+#ifdef __linux__
+
+static sigset_t saved_mask;
+
+static int epoll_add(EventLoop *loop, int fd)
+{
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = fd};
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+int event_loop_init(EventLoop *loop, int input_fd)
+{
+    *loop = (EventLoop){.input_fd = input_fd, .signal_fd = -1, .timer_fd = -1, .epoll_fd = -1, .armed_ns = -1};
+
+    // Blocked signals stay pending for the signalfd instead of interrupting whatever runs
+    sigset_t set;
+    sigemptyset(&set);
+    for (int i = 0; i < HANDLED_SIGNALS; i++)
+        sigaddset(&set, handled_signals[i]);
+    if (pthread_sigmask(SIG_BLOCK, &set, &saved_mask) != 0)
+        return -1;
+
+    loop->signal_fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->signal_fd < 0 || loop->timer_fd < 0 || loop->epoll_fd < 0 || epoll_add(loop, loop->signal_fd) != 0 ||
+        epoll_add(loop, loop->timer_fd) != 0)
+    {
+        event_loop_free(loop);
+        return -1;
+    }
+
+    // epoll refuses regular files (stdin redirected from one); there are no keys to wait for then
+    if (input_fd >= 0 && epoll_add(loop, input_fd) != 0)
+        loop->input_fd = -1;
+    return 0;
+}
+
+void event_loop_free(EventLoop *loop)
+{
+    if (loop->epoll_fd >= 0)
+        close(loop->epoll_fd);
+    if (loop->timer_fd >= 0)
+        close(loop->timer_fd);
+    if (loop->signal_fd >= 0)
+        close(loop->signal_fd);
+    loop->epoll_fd = loop->timer_fd = loop->signal_fd = -1;
+    pthread_sigmask(SIG_SETMASK, &saved_mask, NULL);
+}
+
+int event_loop_watch(EventLoop *loop, int fd)
+{
+    if (loop->watched_count == EVENT_LOOP_MAX_WATCHED || epoll_add(loop, fd) != 0)
+        return -1;
+    loop->watched[loop->watched_count++] = fd;
+    return 0;
+}
+
+/* Point the timer at deadline_ns, or disarm it for -1. */
+static int arm_timer(EventLoop *loop, int64_t deadline_ns)
+{
+    struct itimerspec when = {0};
+    if (deadline_ns > 0)
+        when.it_value = (struct timespec){deadline_ns / NS_PER_SEC, deadline_ns % NS_PER_SEC};
+    if (timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &when, NULL) != 0)
+        return -1;
+    loop->armed_ns = deadline_ns;
+    return 0;
+}
+
+int event_loop_wait(EventLoop *loop, int64_t deadline_ns, Events *events)
+{
+    *events = (Events){0};
+
+    // The timer is only set again when the deadline moved, so most frames cost one epoll_wait()
+    if (deadline_ns != 0 && deadline_ns != loop->armed_ns && arm_timer(loop, deadline_ns) != 0)
+        return -1;
+
+    struct epoll_event ready[4 + EVENT_LOOP_MAX_WATCHED];
+    int count;
+    while ((count = epoll_wait(loop->epoll_fd, ready, sizeof(ready) / sizeof(ready[0]), deadline_ns == 0 ? 0 : -1)) <
+           0)
+    {
+        if (errno != EINTR)
+            return -1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        const int fd = ready[i].data.fd;
+        if (fd == loop->timer_fd)
+        {
+            uint64_t expirations;
+            if (read(fd, &expirations, sizeof(expirations)) > 0)
+                events->flags |= EVENT_FRAME;
+            loop->armed_ns = -1; // One-shot: it disarmed itself
+        }
+        else if (fd == loop->signal_fd)
+        {
+            struct signalfd_siginfo info;
+            while (read(fd, &info, sizeof(info)) == sizeof(info))
+                add_signal_event(events, (int)info.ssi_signo);
+        }
+        else if (fd == loop->input_fd)
+        {
+            read_input(loop, events);
+        }
+    }
+
+    if (deadline_ns == 0)
+        events->flags |= EVENT_FRAME;
+    return 0;
+}
+
+#else
+
+// The handlers' only way to reach the loop; see event_loop_init()
+static int signal_pipe[2] = {-1, -1};
+static struct sigaction saved_actions[HANDLED_SIGNALS];
+
+static void handle_signal(int sig)
+{
+    const int saved_errno = errno;
+    const unsigned char byte = (unsigned char)sig;
+    ssize_t n = write(signal_pipe[1], &byte, 1); // A full pipe already has a wakeup queued
+    (void)n;
+    errno = saved_errno;
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+int event_loop_init(EventLoop *loop, int input_fd)
+{
+    *loop = (EventLoop){.input_fd = input_fd, .signal_fd = -1, .timer_fd = -1, .epoll_fd = -1, .armed_ns = -1};
+
+    if (pipe(signal_pipe) != 0)
+        return -1;
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(signal_pipe[i], F_SETFL, fcntl(signal_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(signal_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    loop->signal_fd = signal_pipe[0];
+
+    struct sigaction sa = {0};
+    sa.sa_handler = handle_signal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    for (int i = 0; i < HANDLED_SIGNALS; i++)
+    {
+        if (sigaction(handled_signals[i], &sa, &saved_actions[i]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+void event_loop_free(EventLoop *loop)
+{
+    for (int i = 0; i < HANDLED_SIGNALS; i++)
+        sigaction(handled_signals[i], &saved_actions[i], NULL);
+    for (int i = 0; i < 2; i++)
+    {
+        if (signal_pipe[i] >= 0)
+            close(signal_pipe[i]);
+        signal_pipe[i] = -1;
+    }
+    loop->signal_fd = -1;
+}
+
+int event_loop_watch(EventLoop *loop, int fd)
+{
+    if (loop->watched_count == EVENT_LOOP_MAX_WATCHED)
+        return -1;
+    loop->watched[loop->watched_count++] = fd;
+    return 0;
+}
+
+int event_loop_wait(EventLoop *loop, int64_t deadline_ns, Events *events)
+{
+    *events = (Events){0};
+
+    struct pollfd fds[2 + EVENT_LOOP_MAX_WATCHED];
+    int count = 0;
+    fds[count++] = (struct pollfd){.fd = loop->signal_fd, .events = POLLIN};
+    const int input = loop->input_fd >= 0 ? count : -1;
+    if (loop->input_fd >= 0)
+        fds[count++] = (struct pollfd){.fd = loop->input_fd, .events = POLLIN};
+    for (int i = 0; i < loop->watched_count; i++)
+        fds[count++] = (struct pollfd){.fd = loop->watched[i], .events = POLLIN};
+
+    // Rounded up, so the wait never ends before the deadline
+    int timeout = -1;
+    if (deadline_ns >= 0)
+    {
+        const int64_t remaining = deadline_ns - now_ns();
+        timeout = remaining > 0 ? (int)((remaining + 999999) / 1000000) : 0;
+    }
+
+    if (poll(fds, count, timeout) < 0 && errno != EINTR)
+        return -1;
+
+    unsigned char sigs[16];
+    ssize_t n;
+    while ((n = read(loop->signal_fd, sigs, sizeof(sigs))) > 0)
+    {
+        for (ssize_t i = 0; i < n; i++)
+            add_signal_event(events, sigs[i]);
+    }
+    if (input >= 0 && (fds[input].revents & (POLLIN | POLLHUP)))
+        read_input(loop, events);
+    if (deadline_ns >= 0 && now_ns() >= deadline_ns)
+        events->flags |= EVENT_FRAME;
+    return 0;
+}
+
+#endif
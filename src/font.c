@@ -0,0 +1,188 @@
+#include <stdlib.h>
+
+#include "font.h"
+
+typedef struct
+{
+    wchar_t ch;
+    uint8_t rows[FONT_HEIGHT];
+} FontGlyph;
+
+// Sorted by character. The katakana follow the shapes of the common 5x8 LCD controller ROMs
+static const FontGlyph glyphs[] = {
+    {L'!', {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}},
+    {L'"', {0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00}},
+    {L'#', {0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a}},
+    {L'$', {0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04}},
+    {L'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+    {L'&', {0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d}},
+    {L'\'', {0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00}},
+    {L'(', {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}},
+    {L')', {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}},
+    {L'*', {0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00}},
+    {L'+', {0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00}},
+    {L',', {0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08}},
+    {L'-', {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}},
+    {L'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}},
+    {L'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+    {L'0', {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}},
+    {L'1', {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}},
+    {L'2', {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}},
+    {L'3', {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}},
+    {L'4', {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}},
+    {L'5', {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}},
+    {L'6', {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}},
+    {L'7', {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {L'8', {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}},
+    {L'9', {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}},
+    {L':', {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00}},
+    {L';', {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08}},
+    {L'<', {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}},
+    {L'=', {0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00}},
+    {L'>', {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}},
+    {L'?', {0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}},
+    {L'@', {0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e}},
+    {L'A', {0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}},
+    {L'B', {0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e}},
+    {L'C', {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e}},
+    {L'D', {0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c}},
+    {L'E', {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f}},
+    {L'F', {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10}},
+    {L'G', {0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f}},
+    {L'H', {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}},
+    {L'I', {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}},
+    {L'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c}},
+    {L'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+    {L'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f}},
+    {L'M', {0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {L'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+    {L'O', {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}},
+    {L'P', {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10}},
+    {L'Q', {0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d}},
+    {L'R', {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11}},
+    {L'S', {0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e}},
+    {L'T', {0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {L'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}},
+    {L'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04}},
+    {L'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a}},
+    {L'X', {0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11}},
+    {L'Y', {0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04}},
+    {L'Z', {0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f}},
+    {L'[', {0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e}},
+    {L'\\', {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}},
+    {L']', {0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e}},
+    {L'^', {0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00}},
+    {L'_', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f}},
+    {L'`', {0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00}},
+    {L'a', {0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f}},
+    {L'b', {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1e}},
+    {L'c', {0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e}},
+    {L'd', {0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f}},
+    {L'e', {0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e}},
+    {L'f', {0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08}},
+    {L'g', {0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e}},
+    {L'h', {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11}},
+    {L'i', {0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e}},
+    {L'j', {0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0c}},
+    {L'k', {0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12}},
+    {L'l', {0x0c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}},
+    {L'm', {0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11}},
+    {L'n', {0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11}},
+    {L'o', {0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e}},
+    {L'p', {0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10}},
+    {L'q', {0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01}},
+    {L'r', {0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10}},
+    {L's', {0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e}},
+    {L't', {0x08, 0x08, 0x1c, 0x08, 0x08, 0x09, 0x06}},
+    {L'u', {0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d}},
+    {L'v', {0x00, 0x00, 0x11, 0x11, 0x11, 0x0a, 0x04}},
+    {L'w', {0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a}},
+    {L'x', {0x00, 0x00, 0x11, 0x0a, 0x04, 0x0a, 0x11}},
+    {L'y', {0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e}},
+    {L'z', {0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f}},
+    {L'{', {0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02}},
+    {L'|', {0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {L'}', {0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08}},
+    {L'~', {0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00}},
+    {0x00a6, {0x04, 0x04, 0x04, 0x00, 0x04, 0x04, 0x04}},
+    {0x254c, {0x00, 0x00, 0x00, 0x1b, 0x00, 0x00, 0x00}},
+    {0x30fb, {0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00}},
+    {0x65e5, {0x1f, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x1f}},
+    {0xff5c, {0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {0xff61, {0x00, 0x00, 0x00, 0x00, 0x1c, 0x14, 0x1c}},
+    {0xff62, {0x1c, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00}},
+    {0xff63, {0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x07}},
+    {0xff64, {0x00, 0x00, 0x00, 0x00, 0x10, 0x08, 0x04}},
+    {0xff65, {0x00, 0x00, 0x00, 0x0c, 0x0c, 0x00, 0x00}},
+    {0xff66, {0x00, 0x1f, 0x01, 0x1f, 0x01, 0x02, 0x04}},
+    {0xff67, {0x00, 0x00, 0x1f, 0x01, 0x06, 0x04, 0x08}},
+    {0xff68, {0x00, 0x00, 0x02, 0x04, 0x0c, 0x14, 0x04}},
+    {0xff69, {0x00, 0x00, 0x04, 0x1f, 0x11, 0x01, 0x06}},
+    {0xff6a, {0x00, 0x00, 0x00, 0x1f, 0x04, 0x04, 0x1f}},
+    {0xff6b, {0x00, 0x00, 0x02, 0x1f, 0x06, 0x0a, 0x12}},
+    {0xff6c, {0x00, 0x00, 0x08, 0x1f, 0x09, 0x0a, 0x08}},
+    {0xff6d, {0x00, 0x00, 0x00, 0x0e, 0x02, 0x02, 0x1f}},
+    {0xff6e, {0x00, 0x00, 0x1e, 0x02, 0x1e, 0x02, 0x1e}},
+    {0xff6f, {0x00, 0x00, 0x00, 0x15, 0x15, 0x02, 0x04}},
+    {0xff70, {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}},
+    {0xff71, {0x1f, 0x01, 0x05, 0x06, 0x04, 0x08, 0x10}},
+    {0xff72, {0x01, 0x02, 0x04, 0x0c, 0x14, 0x04, 0x04}},
+    {0xff73, {0x04, 0x1f, 0x11, 0x11, 0x01, 0x02, 0x04}},
+    {0xff74, {0x00, 0x1f, 0x04, 0x04, 0x04, 0x04, 0x1f}},
+    {0xff75, {0x02, 0x1f, 0x02, 0x06, 0x0a, 0x12, 0x02}},
+    {0xff76, {0x08, 0x1f, 0x09, 0x09, 0x09, 0x09, 0x12}},
+    {0xff77, {0x04, 0x1f, 0x04, 0x1f, 0x04, 0x04, 0x04}},
+    {0xff78, {0x00, 0x0f, 0x09, 0x11, 0x01, 0x02, 0x0c}},
+    {0xff79, {0x08, 0x0f, 0x12, 0x02, 0x02, 0x02, 0x04}},
+    {0xff7a, {0x00, 0x1f, 0x01, 0x01, 0x01, 0x01, 0x1f}},
+    {0xff7b, {0x0a, 0x1f, 0x0a, 0x0a, 0x02, 0x04, 0x08}},
+    {0xff7c, {0x00, 0x18, 0x01, 0x19, 0x01, 0x02, 0x1c}},
+    {0xff7d, {0x00, 0x1f, 0x01, 0x02, 0x04, 0x0a, 0x11}},
+    {0xff7e, {0x08, 0x1f, 0x09, 0x0a, 0x08, 0x08, 0x07}},
+    {0xff7f, {0x00, 0x11, 0x11, 0x09, 0x01, 0x02, 0x0c}},
+    {0xff80, {0x00, 0x0f, 0x09, 0x17, 0x01, 0x02, 0x0c}},
+    {0xff81, {0x02, 0x1c, 0x04, 0x1f, 0x04, 0x04, 0x08}},
+    {0xff82, {0x00, 0x15, 0x15, 0x15, 0x01, 0x02, 0x04}},
+    {0xff83, {0x0e, 0x00, 0x1f, 0x04, 0x04, 0x04, 0x08}},
+    {0xff84, {0x08, 0x08, 0x08, 0x0c, 0x0a, 0x08, 0x08}},
+    {0xff85, {0x04, 0x04, 0x1f, 0x04, 0x04, 0x08, 0x10}},
+    {0xff86, {0x00, 0x0e, 0x00, 0x00, 0x00, 0x00, 0x1f}},
+    {0xff87, {0x00, 0x1f, 0x01, 0x0a, 0x04, 0x0a, 0x10}},
+    {0xff88, {0x04, 0x1f, 0x02, 0x04, 0x0e, 0x15, 0x04}},
+    {0xff89, {0x02, 0x02, 0x02, 0x02, 0x04, 0x08, 0x10}},
+    {0xff8a, {0x00, 0x0a, 0x0a, 0x09, 0x11, 0x11, 0x11}},
+    {0xff8b, {0x10, 0x10, 0x1f, 0x10, 0x10, 0x10, 0x0f}},
+    {0xff8c, {0x00, 0x1f, 0x01, 0x01, 0x01, 0x02, 0x0c}},
+    {0xff8d, {0x00, 0x08, 0x14, 0x12, 0x01, 0x01, 0x00}},
+    {0xff8e, {0x04, 0x1f, 0x04, 0x04, 0x15, 0x15, 0x04}},
+    {0xff8f, {0x00, 0x1f, 0x01, 0x01, 0x0a, 0x04, 0x02}},
+    {0xff90, {0x00, 0x0e, 0x00, 0x0e, 0x00, 0x0e, 0x01}},
+    {0xff91, {0x00, 0x04, 0x08, 0x10, 0x11, 0x1f, 0x01}},
+    {0xff92, {0x00, 0x01, 0x01, 0x0a, 0x04, 0x0a, 0x10}},
+    {0xff93, {0x00, 0x1f, 0x08, 0x1f, 0x08, 0x08, 0x07}},
+    {0xff94, {0x08, 0x08, 0x1f, 0x09, 0x0a, 0x08, 0x08}},
+    {0xff95, {0x00, 0x0e, 0x02, 0x02, 0x02, 0x02, 0x1f}},
+    {0xff96, {0x00, 0x1f, 0x01, 0x1f, 0x01, 0x01, 0x1f}},
+    {0xff97, {0x0e, 0x00, 0x1f, 0x01, 0x01, 0x02, 0x04}},
+    {0xff98, {0x12, 0x12, 0x12, 0x12, 0x02, 0x04, 0x08}},
+    {0xff99, {0x00, 0x04, 0x14, 0x14, 0x15, 0x15, 0x16}},
+    {0xff9a, {0x00, 0x10, 0x10, 0x11, 0x12, 0x14, 0x18}},
+    {0xff9b, {0x00, 0x1f, 0x11, 0x11, 0x11, 0x11, 0x1f}},
+    {0xff9c, {0x00, 0x1f, 0x11, 0x11, 0x01, 0x02, 0x04}},
+    {0xff9d, {0x00, 0x18, 0x01, 0x01, 0x01, 0x02, 0x1c}},
+    {0xff9e, {0x14, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {0xff9f, {0x1c, 0x14, 0x1c, 0x00, 0x00, 0x00, 0x00}},
+};
+
+static int compare_glyph(const void *key, const void *entry)
+{
+    const wchar_t ch = *(const wchar_t *)key;
+    const wchar_t other = ((const FontGlyph *)entry)->ch;
+    return (ch > other) - (ch < other);
+}
+
+const uint8_t *font_glyph(wchar_t ch)
+{
+    const FontGlyph *glyph = bsearch(&ch, glyphs, sizeof(glyphs) / sizeof(glyphs[0]), sizeof(FontGlyph), compare_glyph);
+    return glyph ? glyph->rows : NULL;
+}
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "grid.h"
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+void *grid_reserve(size_t bytes)
+{
+    void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+void grid_release(void *memory, size_t bytes)
+{
+    // Where pages are bigger than the range this fails and the memory stays; it reads as zero either way
+    madvise(memory, bytes, MADV_DONTNEED);
+}
+
+void grid_unreserve(void *memory, size_t bytes)
+{
+    if (memory)
+        munmap(memory, bytes);
+}
+
+int grid_init(Grid *grid, int width, int height, GridLayout layout)
+{
+    *grid = (Grid){0};
+    grid->width = width;
+    grid->height = height;
+    grid->layout = layout;
+    grid->row_stride = layout == GRID_COLUMN_MAJOR ? 1 : (size_t)width;
+    grid->col_stride = layout == GRID_COLUMN_MAJOR ? (size_t)height : 1;
+    grid->cells = (size_t)width * height;
+
+    if (layout == GRID_TILED)
+    {
+        grid->tiles_x = (width + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE;
+        grid->tiles_y = (height + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE;
+        grid->cells = (size_t)grid->tiles_x * grid->tiles_y * GRID_TILE_CELLS;
+    }
+
+    // One block for both planes; the glyph plane comes first so it stays aligned
+    const size_t bytes = grid->cells * (sizeof(uint16_t) + sizeof(uint8_t));
+    uint8_t *block = layout == GRID_TILED ? grid_reserve(bytes) : calloc(bytes, 1);
+    if (!block)
+        return -1;
+
+    grid->glyph = (uint16_t *)block;
+    grid->color = block + grid->cells * sizeof(uint16_t);
+    return 0;
+}
+
+void grid_free(Grid *grid)
+{
+    if (grid->layout == GRID_TILED)
+        grid_unreserve(grid->glyph, grid->cells * (sizeof(uint16_t) + sizeof(uint8_t)));
+    else
+        free(grid->glyph);
+    *grid = (Grid){0};
+}
+
+size_t grid_bytes(const Grid *grid)
+{
+    return grid->cells * (sizeof(uint16_t) + sizeof(uint8_t));
+}
+
+void grid_release_tile(Grid *grid, size_t tile)
+{
+    grid_release(grid->glyph + tile * GRID_TILE_CELLS, GRID_TILE_CELLS * sizeof(uint16_t));
+    grid_release(grid->color + tile * GRID_TILE_CELLS, GRID_TILE_CELLS);
+}
+
+int dirty_map_init(DirtyMap *dirty, int width, int height)
+{
+    *dirty = (DirtyMap){0};
+    dirty->words_per_row = ((size_t)width + 63) / 64;
+    dirty->spans = malloc(height * sizeof(DirtySpan));
+    dirty->bits = calloc(dirty->words_per_row * height, sizeof(uint64_t));
+    if (!dirty->spans || !dirty->bits)
+    {
+        dirty_map_free(dirty);
+        return -1;
+    }
+
+    for (int row = 0; row < height; row++)
+        dirty->spans[row] = (DirtySpan){width, 0};
+    return 0;
+}
+
+void dirty_map_free(DirtyMap *dirty)
+{
+    free(dirty->spans);
+    free(dirty->bits);
+    *dirty = (DirtyMap){0};
+}
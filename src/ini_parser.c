@@ -1,25 +1,241 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+
 #include "ini_parser.h"
+#include "viewport.h"
+
+void settings_defaults(Settings *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    settings->refresh_rate = 50;
+    settings->message_spawn_frame_interval = 5;
+    settings->max_trail_length = 40;
+    settings->threads = 1;
+    settings->load_shedding = true;
+    settings->spawn_density = 1.0;
+    settings->min_speed = 1.0;
+    settings->max_speed = 1.0;
+    settings->flicker_rate = 2.0;
+    settings->flicker_budget = 512;
+    settings->viewport = VIEWPORT_FOLLOW;
+    settings->pan_speed = 1.0;
+}
 
+/* Keep the first problem for the caller to report and reject the line. */
+static int fail(Settings *settings, const char *format, ...)
+{
+    if (settings->error[0] == '\0') {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(settings->error, sizeof(settings->error), format, args);
+        va_end(args);
+    }
+    return 0;
+}
+
+/* Note the first setting skipped for the caller to mention, and go on. */
+static int skip(Settings *settings, const char *section, const char *name)
+{
+    if (settings->warning[0] == '\0') {
+        snprintf(settings->warning, sizeof(settings->warning), "ignoring unknown setting '%s' in [%s]", name, section);
+    }
+    return 1;
+}
+
+int parse_seed(const char *text, uint64_t *seed)
+{
+    // strtoull() takes "-1" as 2^64 - 1; a seed is never negative
+    char *end;
+    errno = 0;
+    const unsigned long long n = strtoull(text, &end, 0);
+    if (end == text || *end != '\0' || errno == ERANGE || text[strspn(text, " \t")] == '-') {
+        return -1;
+    }
+    *seed = n;
+    return 0;
+}
+
+/* A whole-string decimal integer in [min, max], or a failure naming the setting. */
+static int parse_int(Settings *settings, const char *name, const char *value, long min, long max, int *out)
+{
+    char *end;
+    errno = 0;
+    const long n = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE || n < min || n > max) {
+        return fail(settings, "%s must be a whole number from %ld to %ld", name, min, max);
+    }
+    *out = (int)n;
+    return 1;
+}
+
+/* A whole-string decimal number in [min, max], or a failure naming the setting. */
+static int parse_decimal(Settings *settings, const char *name, const char *value, double min, double max,
+                         double *out)
+{
+    char *end;
+    errno = 0;
+    const double x = strtod(value, &end);
+    if (end == value || *end != '\0' || errno == ERANGE || !(x >= min && x <= max)) {
+        return fail(settings, "%s must be a number from %g to %g", name, min, max);
+    }
+    *out = x;
+    return 1;
+}
+
+/* Append one line of the message setting. A value may contain "\n" escapes,
+ * and inih hands us indented continuation lines as repeated "message" keys,
+ * so every call after the first starts a new line.
+ */
+static int append_message(Settings *settings, const char *value)
+{
+    const size_t capacity = sizeof(settings->message)/sizeof(wchar_t) - 1;
+    size_t used = wcslen(settings->message);
+    wchar_t line[MESSAGE_MAX_LENGTH];
+
+    size_t n = mbstowcs(line, value, MESSAGE_MAX_LENGTH - 1);
+    if (n == (size_t)-1) {
+        return fail(settings, "message is not valid in the current locale");
+    }
+    line[n] = L'\0';
+
+    if (used > 0 && used < capacity)
+        settings->message[used++] = L'\n';
+
+    for (size_t i = 0; i < n && used < capacity; i++) {
+        if (line[i] == L'\\' && line[i + 1] == L'n') {
+            settings->message[used++] = L'\n';
+            i++;
+        } else {
+            settings->message[used++] = line[i];
+        }
+    }
+    settings->message[used] = L'\0';
+    return 1;
+}
 
 int handler(void *user, const char *section, const char *name, const char *value)
 {
     Settings *settings = (Settings *)user;
 
     if (MATCH("settings", "message")) {
-        if (strlen(value) > MESSAGE_MAX_LENGTH) {
-            printf("Error: message length exceeds max allowed length\n");
-            return 1;
+        if (strlen(value) + wcslen(settings->message) > MESSAGE_MAX_LENGTH) {
+            return fail(settings, "message length exceeds max allowed length");
         }
-        mbstowcs(settings->message, value, sizeof(settings->message)/sizeof(wchar_t) - 1);
-        settings->message[sizeof(settings->message)/sizeof(wchar_t) - 1] = L'\0';
+        return append_message(settings, value);
+    } else if (MATCH("settings", "symbols")) {
+        size_t n = mbstowcs(settings->symbols, value, SYMBOLS_MAX_LENGTH - 1);
+        if (n == (size_t)-1 || wcsspn(settings->symbols, L" ") == n) {
+            settings->symbols[0] = L'\0';
+            return fail(settings, "symbols must hold at least one printable character");
+        }
+        settings->symbols[n] = L'\0';
     } else if (MATCH("settings", "refresh_rate")) {
-        settings->refresh_rate = atoi(value);
+        return parse_int(settings, name, value, 1, 10000, &settings->refresh_rate);
     } else if (MATCH("settings", "message_spawn_frame_interval")) {
-        settings->message_spawn_frame_interval = atoi(value);
+        return parse_int(settings, name, value, 1, INT_MAX, &settings->message_spawn_frame_interval);
     } else if (MATCH("settings", "max_trail_length")){
-        settings->max_trail_length = atoi(value);
+        return parse_int(settings, name, value, 1, 10000, &settings->max_trail_length);
+    } else if (MATCH("settings", "spawn_density")) {
+        return parse_decimal(settings, name, value, 0, 100, &settings->spawn_density);
+    } else if (MATCH("settings", "min_speed")) {
+        return parse_decimal(settings, name, value, 0.05, 8, &settings->min_speed);
+    } else if (MATCH("settings", "max_speed")) {
+        return parse_decimal(settings, name, value, 0.05, 8, &settings->max_speed);
+    } else if (MATCH("settings", "flicker_rate")) {
+        return parse_decimal(settings, name, value, 0, 100, &settings->flicker_rate);
+    } else if (MATCH("settings", "flicker_budget")) {
+        return parse_int(settings, name, value, 0, INT_MAX, &settings->flicker_budget);
+    } else if (MATCH("settings", "threads")) {
+        return parse_int(settings, name, value, 1, 64, &settings->threads);
+    } else if (MATCH("settings", "seed")) {
+        if (parse_seed(value, &settings->seed) != 0) {
+            return fail(settings, "seed must be a whole number from 0 to %llu", ULLONG_MAX);
+        }
+    } else if (MATCH("settings", "grid_layout")) {
+        if (strcmp(value, "row") == 0) {
+            settings->grid_layout = GRID_ROW_MAJOR;
+        } else if (strcmp(value, "column") == 0) {
+            settings->grid_layout = GRID_COLUMN_MAJOR;
+        } else {
+            return fail(settings, "grid_layout must be 'row' or 'column'");
+        }
+    } else if (MATCH("settings", "canvas_width")) {
+        return parse_int(settings, name, value, 0, CANVAS_MAX_SIZE, &settings->canvas_width);
+    } else if (MATCH("settings", "canvas_height")) {
+        return parse_int(settings, name, value, 0, CANVAS_MAX_SIZE, &settings->canvas_height);
+    } else if (MATCH("settings", "viewport")) {
+        if (strcmp(value, "fixed") == 0) {
+            settings->viewport = VIEWPORT_FIXED;
+        } else if (strcmp(value, "pan") == 0) {
+            settings->viewport = VIEWPORT_PAN;
+        } else if (strcmp(value, "follow") == 0) {
+            settings->viewport = VIEWPORT_FOLLOW;
+        } else {
+            return fail(settings, "viewport must be 'fixed', 'pan' or 'follow'");
+        }
+    } else if (MATCH("settings", "viewport_x")) {
+        return parse_int(settings, name, value, 0, CANVAS_MAX_SIZE, &settings->viewport_x);
+    } else if (MATCH("settings", "viewport_y")) {
+        return parse_int(settings, name, value, 0, CANVAS_MAX_SIZE, &settings->viewport_y);
+    } else if (MATCH("settings", "pan_speed")) {
+        return parse_decimal(settings, name, value, 0, 1000, &settings->pan_speed);
+    } else if (MATCH("settings", "frame_policy")) {
+        if (strcmp(value, "skip") == 0) {
+            settings->frame_policy = FRAME_SKIP;
+        } else if (strcmp(value, "catch_up") == 0) {
+            settings->frame_policy = FRAME_CATCH_UP;
+        } else {
+            return fail(settings, "frame_policy must be 'skip' or 'catch_up'");
+        }
+    } else if (MATCH("settings", "colors")) {
+        if (strcmp(value, "basic") == 0) {
+            settings->colors = COLORS_BASIC;
+        } else if (strcmp(value, "256") == 0) {
+            settings->colors = COLORS_256;
+        } else if (strcmp(value, "truecolor") == 0) {
+            settings->colors = COLORS_TRUECOLOR;
+        } else {
+            return fail(settings, "colors must be 'basic', '256' or 'truecolor'");
+        }
+    } else if (MATCH("settings", "load_shedding")) {
+        if (strcmp(value, "on") == 0) {
+            settings->load_shedding = true;
+        } else if (strcmp(value, "off") == 0) {
+            settings->load_shedding = false;
+        } else {
+            return fail(settings, "load_shedding must be 'on' or 'off'");
+        }
+    } else if (MATCH("settings", "output_budget")) {
+        return parse_int(settings, name, value, 0, INT_MAX, &settings->output_budget);
+    } else if (MATCH("settings", "hud")) {
+        if (strcmp(value, "on") == 0) {
+            settings->hud = true;
+        } else if (strcmp(value, "off") == 0) {
+            settings->hud = false;
+        } else {
+            return fail(settings, "hud must be 'on' or 'off'");
+        }
+    } else if (MATCH("settings", "stats_socket")) {
+        if (strlen(value) >= STATS_SOCKET_PATH_LENGTH) {
+            return fail(settings, "stats_socket must be shorter than %d characters", STATS_SOCKET_PATH_LENGTH);
+        }
+        strcpy(settings->stats_socket, value);
+    } else if (MATCH("settings", "shm_export")) {
+        if (value[0] && (value[0] != '/' || strchr(value + 1, '/'))) {
+            return fail(settings, "shm_export must be a name like /matrix");
+        }
+        if (strlen(value) >= SHM_EXPORT_NAME_LENGTH) {
+            return fail(settings, "shm_export must be shorter than %d characters", SHM_EXPORT_NAME_LENGTH);
+        }
+        strcpy(settings->shm_export, value);
+    } else if (MATCH("settings", "renderer")) {
+        if (strlen(value) >= RENDERER_NAME_LENGTH) {
+            return fail(settings, "unknown renderer '%s'", value);
+        }
+        strcpy(settings->renderer, value);
     } else {
-        return 0;
+        return skip(settings, section, name);
     }
     return 1;
-}
\ No newline at end of file
+}
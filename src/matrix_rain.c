@@ -5,587 +5,677 @@
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 
 #include "ini_parser.h"
-
-typedef enum
-{
-    COLOR_BRIGHT_GREEN = 8, // First 8 slots are reserved by ncurses
-    COLOR_DIMMER_GREEN,
-    COLOR_DARK_GREEN
-} Color;
-
-typedef enum
+#include "rain.h"
+#include "damage.h"
+#include "render.h"
+#include "bench.h"
+#include "microbench.h"
+#include "scheduler.h"
+#include "pipeline.h"
+#include "recording.h"
+#include "watch.h"
+#include "metrics.h"
+#include "throttle.h"
+#include "broadcast.h"
+#include "events.h"
+#include "shm_export.h"
+#include "viewport.h"
+
+#define SETTINGS_PATH "settings.ini"
+
+void handle_quit(int sig);
+int install_signal_handlers();
+int apply_resize(const Renderer *renderer, Rain *rain, Viewport *view, FrontBuffer *front);
+int load_settings(Settings *settings);
+int parse_option(const char *option, const char *text, long min, long max, long *value);
+void print_usage(const char *prog);
+
+// Set by SIGINT / SIGTERM; the main loop finishes the frame and cleans up
+static volatile sig_atomic_t quit_requested = 0;
+
+int main(int argc, char **argv)
 {
-    PAIR_WHITE = 1,
-    PAIR_BRIGHT_GREEN,
-    PAIR_DIMMER_GREEN,
-    PAIR_DARK_GREEN
-} ColorPair;
+    bool bench = false;
+    bool microbench = false;
+    MicrobenchOptions microbench_options = {
+        .threshold = 25,
+    };
+    const char *renderer_name = NULL;
+    uint64_t seed = 0;
+    const char *record_path = NULL;
+    const char *play_path = NULL;
+    const char *cast_path = NULL;
+    int play_rate = 0;
+    const char *serve_address = NULL;
+    const char *connect_address = NULL;
+    long frame_limit = 0; // Live mode runs until quit without --frames
+    bool sized = false;
+    BenchOptions bench_options = {
+        .frames = 1000,
+        .width = 200,
+        .height = 60,
+    };
+
+    static const struct option long_options[] = {
+        {"bench", no_argument, NULL, 'b'},
+        {"frames", required_argument, NULL, 'f'},
+        {"size", required_argument, NULL, 's'},
+        {"seed", required_argument, NULL, 'S'},
+        {"renderer", required_argument, NULL, 'r'},
+        {"paced", no_argument, NULL, 'p'},
+        {"record", required_argument, NULL, 'R'},
+        {"play", required_argument, NULL, 'P'},
+        {"rate", required_argument, NULL, 't'},
+        {"cast", required_argument, NULL, 'c'},
+        {"serve", required_argument, NULL, 'v'},
+        {"connect", required_argument, NULL, 'C'},
+        {"microbench", no_argument, NULL, 'm'},
+        {"results", required_argument, NULL, 'o'},
+        {"baseline", required_argument, NULL, 'B'},
+        {"threshold", required_argument, NULL, 'T'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    long number;
+    while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            bench = true;
+            break;
+        case 'f':
+            if (parse_option("--frames", optarg, 1, LONG_MAX, &frame_limit) != 0)
+                return 1;
+            bench_options.frames = frame_limit;
+            break;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &bench_options.width, &bench_options.height) != 2)
+            {
+                fprintf(stderr, "Error: --size expects WIDTHxHEIGHT\n");
+                return 1;
+            }
+            sized = true;
+            break;
+        case 'S':
+            if (parse_seed(optarg, &seed) != 0)
+            {
+                fprintf(stderr, "Error: --seed expects a whole number from 0 to %llu\n", ULLONG_MAX);
+                return 1;
+            }
+            break;
+        case 'r':
+            renderer_name = optarg;
+            break;
+        case 'p':
+            bench_options.paced = true;
+            break;
+        case 'R':
+            record_path = optarg;
+            break;
+        case 'P':
+            play_path = optarg;
+            break;
+        case 't':
+            if (parse_option("--rate", optarg, 1, 10000, &number) != 0)
+                return 1;
+            play_rate = (int)number;
+            break;
+        case 'c':
+            cast_path = optarg;
+            break;
+        case 'v':
+            serve_address = optarg;
+            break;
+        case 'C':
+            connect_address = optarg;
+            break;
+        case 'm':
+            microbench = true;
+            break;
+        case 'o':
+            microbench_options.results = optarg;
+            break;
+        case 'B':
+            microbench_options.baseline = optarg;
+            break;
+        case 'T':
+            if (parse_option("--threshold", optarg, 0, 10000, &number) != 0)
+                return 1;
+            microbench_options.threshold = (int)number;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
 
-typedef struct
-{
-    int column;
-    int head_row;
-    int length;
-    int max_length;
-    bool active;
-} Trail;
-
-typedef struct
-{
-    wchar_t symbol;
-    int color;
-} Glyph;
-
-void handle_winch(int sig);
-int init_colors();
-wchar_t get_random_symbol();
-void draw_symbol(int row, int col, wchar_t ch, ColorPair color_pair,
-                 Glyph **glyph_matrix, int max_width, int max_height);
-void erase_symbol(int row, int col, Glyph **glyph_matrix, int max_width);
-bool is_message_column(size_t message_len, int column, int *message_columns);
-wchar_t get_message_char(size_t message_len, int column, int *message_columns, const wchar_t *message);
-int would_overwrite_revealed_message(int row, int col, wchar_t ch, int middle_row,
-                                     size_t message_len, int *message_columns, bool *message_revealed);
-
-const wchar_t *matrix_symbols = L"日ﾊﾐﾋｰｳｼﾅﾓﾆｻﾜﾂｵﾘｱﾎﾃﾏｹﾒｴｶｷﾑﾕﾗｾﾈｽﾀﾇﾍ012345789Z:・.=*+-<>¦｜╌";
-
-int main()
-{
-    srand((unsigned)time(NULL));
+    if ((bench || serve_address || frame_limit) && (bench_options.frames <= 0 || bench_options.width <= 0 || bench_options.height <= 0))
+    {
+        fprintf(stderr, "Error: --frames and --size must be positive\n");
+        return 1;
+    }
 
     setlocale(LC_ALL, "");
-    int height, width;
 
-    signal(SIGWINCH, handle_winch);
+    Settings settings;
+    const int parsed = load_settings(&settings);
+    if (parsed < 0)
+    {
+        printf("Can't load '%s'\n", SETTINGS_PATH);
+        return 1;
+    }
+    if (parsed > 0)
+    {
+        printf("Error: %s (%s line %d)\n", settings.error[0] ? settings.error : "syntax error", SETTINGS_PATH, parsed);
+        return 1;
+    }
+    if (settings.warning[0])
+        fprintf(stderr, "Warning: %s (%s)\n", settings.warning, SETTINGS_PATH);
+
+    // --seed wins over settings.ini; with neither, bench runs are repeatable and live ones are not
+    if (seed)
+        settings.seed = seed;
+    if (!settings.seed)
+        settings.seed = bench ? 1 : ((uint64_t)time(NULL) << 20) ^ (uint64_t)getpid();
 
-    initscr();
-    curs_set(0);
-    getmaxyx(stdscr, height, width);
-    cbreak();
-    noecho();
-    keypad(stdscr, TRUE);
+    // The command line wins over settings.ini; ncurses unless either picks another
+    if (!renderer_name)
+        renderer_name = settings.renderer[0] ? settings.renderer : "ncurses";
 
-    if (init_colors() == 1)
+    const Renderer *renderer = renderer_find(renderer_name);
+    if (!renderer)
     {
+        printf("Error: unknown renderer '%s'\n", renderer_name);
         return 1;
     }
+    if (settings.output_budget && !renderer->bytes_written)
+        fprintf(stderr, "Warning: the %s renderer can't count its output; output_budget only limits the queue\n",
+                renderer->name);
 
-    Settings settings;
+    if (play_path && cast_path)
+    {
+        return playback_export_cast(play_path, cast_path, play_rate);
+    }
 
-    if (ini_parse("settings.ini", handler, &settings) < 0)
+    if (microbench)
     {
-        printf("Can't load 'settings.ini'\n");
-        return 1;
+        return microbench_run(&settings, &microbench_options);
+    }
+
+    if (bench)
+    {
+        bench_options.record = record_path;
+        return bench_run(&settings, &bench_options, renderer);
     }
 
-    const wchar_t *message = settings.message;
-    const size_t message_len = wcslen(message);
-    if (message_len > width)
+    int height = 0, width = 0;
+
+    // Installed before the renderer so ncurses does not install its own handlers
+    if (install_signal_handlers() != 0)
     {
-        printf("Error: message exceeds terminal width.\n");
+        perror("sigaction");
         return 1;
     }
 
-    const int middle_row = height / 2;
-    int message_columns[message_len];
-    bool message_revealed[message_len]; // Track which message characters have been revealed
-    int frame_counter = 0;
-    int last_message_spawn_frame = 0;
-    int message_spawn_frame_interval = settings.message_spawn_frame_interval; // Spawn a message trail every n frames (0.5 seconds at 100ms per frame)
+    if (play_path)
+    {
+        return playback_run(play_path, renderer, play_rate, &quit_requested);
+    }
 
-    const int leftmost_column = (int)(width / 2) - (int)(message_len / 2);
+    if (connect_address)
+    {
+        return broadcast_connect(connect_address, &quit_requested);
+    }
 
-    for (int i = 0; i < message_len; i++)
+    if (serve_address)
     {
-        message_columns[i] = leftmost_column + i;
-        message_revealed[i] = false; // Initially no characters are revealed
+        return broadcast_serve(&settings, serve_address, bench_options.width, bench_options.height, &quit_requested);
     }
 
-    // dynamically allocate glyph_matrix
-    Glyph **glyph_matrix = malloc(height * sizeof(Glyph *));
-    if (!glyph_matrix)
+    // Before the renderer or the simulation start a thread, which would otherwise take the signals
+    EventLoop loop;
+    if (event_loop_init(&loop, STDIN_FILENO) != 0)
     {
-        endwin();
+        perror("event loop");
         return 1;
     }
-    for (int i = 0; i < height; i++)
+
+    // Offscreen output has no terminal to take the size from
+    if (renderer->offscreen && sized)
     {
-        glyph_matrix[i] = malloc(width * sizeof(Glyph));
-        if (!glyph_matrix[i])
-        {
-            for (int k = 0; k < i; k++)
-                free(glyph_matrix[k]);
-            free(glyph_matrix);
-            endwin();
-            return 1;
-        }
-        for (int j = 0; j < width; j++)
-            glyph_matrix[i][j].symbol = L' ';
+        width = bench_options.width;
+        height = bench_options.height;
+    }
+    video_set_frame_period(settings.refresh_rate);
+    if (renderer->init(STDOUT_FILENO, &width, &height) == 1)
+    {
+        return 1;
     }
 
-    const size_t max_trails = width + width * (height / settings.max_trail_length);
-    Trail trails[max_trails];
-    size_t num_trails = 0;
+    // A canvas bigger than the terminal is simulated whole and shown through a view of the terminal's size
+    const bool canvas = settings.canvas_width || settings.canvas_height;
+    Rain rain;
+    RainStatus status = rain_init(&rain, &settings, settings.canvas_width ? settings.canvas_width : width,
+                                  settings.canvas_height ? settings.canvas_height : height);
+    Viewport view = {0};
+    if (status == RAIN_OK && canvas && viewport_init(&view, &settings, width, height, rain.width, rain.height) != 0)
+    {
+        rain_free(&rain);
+        status = RAIN_ERR_ALLOC;
+    }
+    if (status != RAIN_OK)
+    {
+        renderer->shutdown();
+        printf("Error: %s.\n", rain_strerror(status));
+        return 1;
+    }
+    const Grid *shown = canvas ? &view.grid : &rain.grid; // What the terminal shows, and what changed in it
+    DirtyMap *shown_dirty = canvas ? &view.dirty : &rain.dirty;
+
+    // The HUD's characters join the palette before anything copies it
+    Hud hud;
+    hud_init(&hud);
+    FrontBuffer front;
+    if ((settings.hud && hud_show(&hud, &rain.palette) < 0) ||
+        front_buffer_init(&front, width, height, shown->layout) != 0)
+    {
+        renderer->shutdown();
+        hud_free(&hud);
+        rain_free(&rain);
+        printf("Error: %s.\n", rain_strerror(RAIN_ERR_ALLOC));
+        return 1;
+    }
 
-    for (int i = 0; i < max_trails; i++)
+    // With more than one thread, output runs on its own thread a frame behind
+    RenderPipeline pipeline;
+    const bool pipelined = settings.threads > 1;
+    if (pipelined && render_pipeline_start(&pipeline, renderer, &rain.palette) != 0)
     {
-        trails[i].active = 0;
+        renderer->shutdown();
+        front_buffer_free(&front);
+        hud_free(&hud);
+        viewport_free(&view);
+        rain_free(&rain);
+        printf("Error: can't start the render thread.\n");
+        return 1;
     }
 
-    while (1)
+    Recorder recorder;
+    if (record_path && recorder_open(&recorder, record_path, width, height, settings.refresh_rate, &rain.palette) != 0)
     {
-        for (size_t i = 0; i < max_trails; i++)
-        {
-            Trail *current = &trails[i];
-            if (!current->active)
-                continue;
+        if (pipelined)
+            render_pipeline_stop(&pipeline);
+        renderer->shutdown();
+        front_buffer_free(&front);
+        hud_free(&hud);
+        viewport_free(&view);
+        rain_free(&rain);
+        perror(record_path);
+        return 1;
+    }
 
-            const int head_row = current->head_row;
-            const int column = current->column;
+    // Opened once: unlike the HUD, stats_socket is not followed on reload
+    int stats_fd = -1;
+    if (settings.stats_socket[0] && (stats_fd = stats_socket_open(settings.stats_socket)) < 0)
+    {
+        if (pipelined)
+            render_pipeline_stop(&pipeline);
+        renderer->shutdown();
+        if (record_path)
+            recorder_close(&recorder);
+        front_buffer_free(&front);
+        hud_free(&hud);
+        viewport_free(&view);
+        rain_free(&rain);
+        perror(settings.stats_socket);
+        return 1;
+    }
 
-            /* HEAD - reveal message character if head passes over it */
-            if (head_row >= 0 && head_row < height)
+    // Opened once as well; a resize only ever grows it
+    ShmExport shm;
+    const bool exporting = settings.shm_export[0] != '\0';
+    if (exporting && shm_export_open(&shm, settings.shm_export, shown, &rain.palette) != 0)
+    {
+        if (pipelined)
+            render_pipeline_stop(&pipeline);
+        renderer->shutdown();
+        if (record_path)
+            recorder_close(&recorder);
+        if (stats_fd >= 0)
+            stats_socket_close(stats_fd, settings.stats_socket);
+        front_buffer_free(&front);
+        hud_free(&hud);
+        viewport_free(&view);
+        rain_free(&rain);
+        perror(settings.shm_export);
+        return 1;
+    }
+
+    // Without the HUD or the socket nothing reads the metrics, so none are taken
+    Metrics metrics;
+    metrics_init(&metrics, renderer);
+    bool measuring = hud.enabled || stats_fd >= 0;
+
+    FrameScheduler scheduler;
+    scheduler_init(&scheduler, settings.refresh_rate, settings.frame_policy);
+    int period_ms = settings.refresh_rate; // What the keys speed up or slow down
+
+    // Thins the rain out while the terminal (e.g. over SSH) can't keep up
+    Throttle throttle;
+    throttle_init(&throttle, STDOUT_FILENO, settings.output_budget, renderer);
+    bool shedding = settings.load_shedding && !renderer->offscreen;
+
+    // Without a watch the animation simply keeps its startup settings
+    FileWatch watch;
+    const bool watching = file_watch_init(&watch, SETTINGS_PATH) == 0;
+    if (watching && watch.fd >= 0)
+        event_loop_watch(&loop, watch.fd);
+    if (stats_fd >= 0)
+        event_loop_watch(&loop, stats_fd);
+
+    int exit_status = 0;
+    char error[256] = ""; // Why the loop stopped, told once the terminal is given back
+    int steps = 1;       // The first frame goes out at once
+    bool redraw = false; // A frame without steps, to show a resize at once
+    bool paused = false;
+    bool quit = false;
+    long frames = 0;
+    while (!quit)
+    {
+        if (steps > 0 || redraw)
+        {
+            if (steps > 0 && frame_limit && frames++ == frame_limit)
+                break;
+            if (measuring)
+                metrics_begin_frame(&metrics);
+            for (int i = 0; i < steps; i++)
             {
-                if (head_row == middle_row && is_message_column(message_len, column, message_columns))
-                {
-                    // Reveal the message character at this position
-                    for (int j = 0; j < message_len; j++)
-                    {
-                        if (message_columns[j] == column)
-                        {
-                            message_revealed[j] = true;
-                            break;
-                        }
-                    }
-                    // Draw the revealed message character
-                    wchar_t ch = get_message_char(message_len, column, message_columns, message);
-                    draw_symbol(head_row, column, ch, PAIR_WHITE, glyph_matrix, width, height);
-                }
-                else
-                {
-                    wchar_t ch = get_random_symbol();
-                    // Check if this character would overwrite revealed message characters
-                    if (!would_overwrite_revealed_message(head_row, column, ch, middle_row,
-                                                          message_len, message_columns, message_revealed))
-                    {
-                        draw_symbol(head_row, column, ch, PAIR_WHITE, glyph_matrix, width, height);
-                    }
-                }
+                rain_step(&rain);
+                if (measuring)
+                    metrics_step(&metrics, &rain);
             }
-
-            /* BODY: immediate above head - but skip if it would overwrite revealed message */
-            int r = head_row - 1;
-            if (r >= 0 && r < height)
+            if (canvas)
             {
-                if (r == middle_row && is_message_column(message_len, column, message_columns))
-                {
-                    // Check if this message character is revealed
-                    bool is_revealed = false;
-                    for (int j = 0; j < message_len; j++)
-                    {
-                        if (message_columns[j] == column && message_revealed[j])
-                        {
-                            is_revealed = true;
-                            break;
-                        }
-                    }
-                    if (!is_revealed)
-                    {
-                        // Not revealed yet, draw normal trail character
-                        wchar_t ch = glyph_matrix[r][column].symbol;
-                        draw_symbol(r, column, ch, PAIR_BRIGHT_GREEN, glyph_matrix, width, height);
-                    }
-                }
-                else
-                {
-                    wchar_t ch = glyph_matrix[r][column].symbol;
-                    // Check if this character would overwrite revealed message characters
-                    if (!would_overwrite_revealed_message(r, column, ch, middle_row,
-                                                          message_len, message_columns, message_revealed))
-                    {
-                        draw_symbol(r, column, ch, PAIR_BRIGHT_GREEN, glyph_matrix, width, height);
-                    }
-                }
+                int focus_row = rain.height / 2, focus_col = rain.width / 2;
+                rain_message_center(&rain, &focus_row, &focus_col);
+                viewport_move(&view, steps, focus_row, focus_col);
+                viewport_sync(&view, &rain.grid, &rain.dirty);
             }
-
-            /* DIMMER: halfway above head */
-            r = head_row - (settings.max_trail_length / 2 + 1);
-            if (r >= 0 && r < height)
+            if (renderer->frame_lost && renderer->frame_lost())
             {
-                if (r == middle_row && is_message_column(message_len, column, message_columns))
-                {
-                    // Check if this message character is revealed
-                    bool is_revealed = 0;
-                    for (size_t j = 0; j < message_len; j++)
-                    {
-                        if (message_columns[j] == column && message_revealed[j])
-                        {
-                            is_revealed = true;
-                            break;
-                        }
-                    }
-                    if (!is_revealed)
-                    {
-                        // Not revealed yet, draw normal trail character
-                        wchar_t ch = glyph_matrix[r][column].symbol;
-                        draw_symbol(r, column, ch, PAIR_DIMMER_GREEN, glyph_matrix, width, height);
-                    }
-                }
-                else
+                // The terminal missed a frame the front copy took in: send every cell again
+                for (int row = 0; row < front.front.height; row++)
                 {
-                    wchar_t ch = glyph_matrix[r][column].symbol;
-                    // Check if this character would overwrite revealed message characters
-                    if (!would_overwrite_revealed_message(r, column, ch, middle_row,
-                                                          message_len, message_columns, message_revealed))
-                    {
-                        draw_symbol(r, column, ch, PAIR_DIMMER_GREEN, glyph_matrix, width, height);
-                    }
+                    front_buffer_invalidate_row(&front, row);
+                    dirty_map_mark(shown_dirty, row, 0, front.front.width);
                 }
+                hud_invalidate(&hud);
             }
-
-            /* DARK: 3/4 of the max length above head */
-            r = head_row - (((settings.max_trail_length / 4) * 3) + 1);
-            if (r >= 0 && r < height)
+            if (front_buffer_diff(&front, shown, shown_dirty) != 0)
             {
-                if (r == middle_row && is_message_column(message_len, column, message_columns))
-                {
-                    // Check if this message character is revealed
-                    bool is_revealed = false;
-                    for (size_t j = 0; j < message_len; j++)
-                    {
-                        if (message_columns[j] == column && message_revealed[j])
-                        {
-                            is_revealed = true;
-                            break;
-                        }
-                    }
-                    if (!is_revealed)
-                    {
-                        // Not revealed yet, draw normal trail character
-                        const wchar_t ch = glyph_matrix[r][column].symbol;
-                        draw_symbol(r, column, ch, PAIR_DARK_GREEN, glyph_matrix, width, height);
-                    }
-                }
-                else
-                {
-                    wchar_t ch = glyph_matrix[r][column].symbol;
-                    // Check if this character would overwrite revealed message characters
-                    if (!would_overwrite_revealed_message(r, column, ch, middle_row,
-                                                          message_len, message_columns, message_revealed))
-                    {
-                        draw_symbol(r, column, ch, PAIR_DARK_GREEN, glyph_matrix, width, height);
-                    }
-                }
+                snprintf(error, sizeof(error), "%s", rain_strerror(RAIN_ERR_ALLOC));
+                exit_status = 1;
+                break;
             }
-
-            const int tail_row = current->head_row - current->length;
-
-            if (tail_row >= 0 && tail_row < height)
+            if (record_path)
+                recorder_frame(&recorder, &front.list); // Without the HUD
+            if (exporting && shm_export_frame(&shm, shown, &rain.palette) != 0)
             {
-                // Don't erase revealed message characters
-                if (tail_row == middle_row && is_message_column(message_len, column, message_columns))
-                {
-                    // Check if this message character is revealed
-                    bool is_revealed = 0;
-                    for (size_t j = 0; j < message_len; j++)
-                    {
-                        if (message_columns[j] == column && message_revealed[j])
-                        {
-                            is_revealed = true;
-                            break;
-                        }
-                    }
-                    if (!is_revealed)
-                    {
-                        // Not revealed yet, can erase
-                        erase_symbol(tail_row, column, glyph_matrix, width);
-                    }
-                }
-                else
-                {
-                    erase_symbol(tail_row, column, glyph_matrix, width);
-                }
+                snprintf(error, sizeof(error), "%s: %s", settings.shm_export, strerror(errno));
+                exit_status = 1;
+                break;
             }
-
-            // ...inside the main trail loop, after head_row > 0 check...
-
-            if (tail_row >= height)
+            if (hud.enabled && hud_draw(&hud, &metrics, &front) != 0)
+            {
+                snprintf(error, sizeof(error), "drawing the HUD: %s", rain_strerror(RAIN_ERR_ALLOC));
+                exit_status = 1;
+                break;
+            }
+            if (shedding)
+                throttle_begin_output(&throttle);
+            if (pipelined)
+                render_pipeline_submit(&pipeline, &front.list);
+            else
+                renderer->present(&front.list, &rain.palette);
+            if (shedding)
             {
-                current->active = false;
-                num_trails--;
+                throttle_end_output(&throttle);
+                const int level = throttle_update(&throttle, renderer);
+                if (level != rain.load_level)
+                    rain_set_load_level(&rain, level);
             }
+            if (measuring)
+                metrics_end_frame(&metrics, &rain, &front, renderer);
+            redraw = false;
+        }
+
+        // Offscreen frames are made as fast as possible; paused, only an event wakes the process
+        Events events;
+        const int64_t deadline = renderer->offscreen ? 0 : paused ? -1 : scheduler.deadline_ns;
 
-            current->head_row++;
+        // Taken just before every wait: a deadline already gone counts as missed, waking late from one does not
+        const bool overran = scheduler_overran(&scheduler);
+        if (event_loop_wait(&loop, deadline, &events) != 0)
+        {
+            perror("event loop");
+            break;
         }
+        steps = 0;
+        if ((events.flags & EVENT_FRAME) && !paused)
+            steps = renderer->offscreen ? 1 : scheduler_take(&scheduler, overran);
+        if (events.flags & EVENT_QUIT)
+            quit = true;
 
-        // Draw only the revealed message characters
-        for (int i = 0; i < message_len; i++)
+        for (int i = 0; i < events.key_count; i++)
         {
-            if (message_revealed[i])
+            switch (events.keys[i])
             {
-                int msg_col = message_columns[i];
-                wchar_t ch = message[i];
-                draw_symbol(middle_row, msg_col, ch, PAIR_WHITE, glyph_matrix, width, height);
+            case ' ':
+            case 'p':
+                paused = !paused;
+                if (!paused)
+                    scheduler_restart(&scheduler); // The pause is not a run of missed frames
+                break;
+            case '+':
+            case '=':
+                period_ms = period_ms * 4 / 5 > 1 ? period_ms * 4 / 5 : 1;
+                scheduler_set_period(&scheduler, period_ms);
+                break;
+            case '-':
+            case '_':
+                period_ms = period_ms * 5 / 4 > period_ms ? period_ms * 5 / 4 : period_ms + 1;
+                if (period_ms > 10000)
+                    period_ms = 10000;
+                scheduler_set_period(&scheduler, period_ms);
+                break;
+            case 'q':
+            case 'Q':
+                quit = true;
+                break;
             }
         }
 
-        // Smart trail spawning - prioritize unrevealed message columns
-        frame_counter++;
-        const int should_spawn_message_trail = (frame_counter - last_message_spawn_frame) >= message_spawn_frame_interval;
-
-        // Add new trail if space available
-        if (num_trails < max_trails)
+        if (events.flags & EVENT_RESIZE)
         {
-            bool spawned = false;
-
-            // First priority: spawn a trail in an unrevealed message column if it's time
-            if (should_spawn_message_trail)
+            if (pipelined)
+                render_pipeline_sync(&pipeline);
+            const int resized = apply_resize(renderer, &rain, canvas ? &view : NULL, &front);
+            if (resized < 0)
             {
-                for (int msg_idx = 0; msg_idx < message_len; msg_idx++)
-                {
-                    if (!message_revealed[msg_idx])
-                    {
-                        int msg_col = message_columns[msg_idx];
-                        // Check if this column is available for a new trail
-                        int left_ok = (glyph_matrix[0][msg_col].symbol == L' ');
-                        int left_left_ok = (msg_col > 0) ? (glyph_matrix[0][msg_col - 1].symbol == L' ') : 1;
-                        int right_ok = (msg_col < width - 1) ? (glyph_matrix[0][msg_col + 1].symbol == L' ') : 1;
-
-                        if (left_ok && left_left_ok && right_ok)
-                        {
-                            // Find an inactive trail to use
-                            for (int i = 0; i < max_trails; i++)
-                            {
-                                if (!trails[i].active)
-                                {
-                                    trails[i].column = msg_col;
-                                    trails[i].head_row = 0;
-                                    trails[i].length = settings.max_trail_length;
-                                    trails[i].max_length = settings.max_trail_length;
-                                    trails[i].active = true;
-                                    num_trails++;
-                                    spawned = true;
-                                    last_message_spawn_frame = frame_counter;
-                                    break;
-                                }
-                            }
-                            break; // Only spawn one message trail at a time
-                        }
-                    }
-                }
+                snprintf(error, sizeof(error), "resizing: %s", rain_strerror(RAIN_ERR_ALLOC));
+                exit_status = 1;
+                break;
             }
-
-            // Second priority: spawn regular random trails if we didn't spawn a message trail
-            if (!spawned)
+            if (resized && record_path)
+                recorder_resize(&recorder, front.front.width, front.front.height);
+            if (resized)
             {
-                for (size_t i = 0; i < max_trails; i++)
-                {
-                    if (!trails[i].active)
-                    {
-                        int random_column = rand() % width;
-
-                        // avoid starting in or next to an occupied cell (also treats right-half as occupied)
-                        int left_ok = (glyph_matrix[0][random_column].symbol == L' ');
-                        int left_left_ok = (random_column > 0) ? (glyph_matrix[0][random_column - 1].symbol == L' ') : 1;
-                        int right_ok = (random_column < width - 1) ? (glyph_matrix[0][random_column + 1].symbol == L' ') : 1;
-
-                        if (!left_ok || !left_left_ok || !right_ok)
-                        {
-                            continue;
-                        }
-
-                        trails[i].column = random_column;
-                        trails[i].head_row = 0;
-                        trails[i].length = settings.max_trail_length;
-                        trails[i].max_length = settings.max_trail_length;
-                        trails[i].active = 1;
-                        num_trails++;
-                        break;
-                    }
-                }
+                hud_invalidate(&hud);
+                redraw = true;
             }
         }
 
-        refresh();
-        napms(settings.refresh_rate);
-    }
-
-    endwin();
+        if (stats_fd >= 0)
+            stats_socket_serve(stats_fd, &metrics);
 
-    for (int i = 0; i < height; i++)
-        free(glyph_matrix[i]);
-    free(glyph_matrix);
+        // An edited settings.ini that does not validate is ignored
+        Settings edited;
+        if (watching && file_watch_changed(&watch) && load_settings(&edited) == 0)
+        {
+            if (pipelined)
+                render_pipeline_sync(&pipeline); // The palette may grow
+            const size_t known_symbols = rain.palette.count;
+            const RainStatus applied = rain_apply_settings(&rain, &edited);
+            if (applied != RAIN_OK || (edited.hud && !hud.enabled && hud_show(&hud, &rain.palette) < 0))
+            {
+                snprintf(error, sizeof(error), "%s (settings.ini)",
+                         rain_strerror(applied != RAIN_OK ? applied : RAIN_ERR_ALLOC));
+                exit_status = 1;
+                break;
+            }
+            if (canvas)
+                viewport_apply_settings(&view, &edited);
+            if (!edited.hud && hud.enabled)
+                hud_hide(&hud, &front, shown_dirty);
+            measuring = hud.enabled || stats_fd >= 0;
+            if (record_path && rain.palette.count != known_symbols)
+                recorder_palette(&recorder, &rain.palette, known_symbols);
+            if (edited.load_shedding && !renderer->offscreen && !shedding)
+                throttle_init(&throttle, STDOUT_FILENO, edited.output_budget, renderer);
+            else if (!edited.load_shedding && shedding)
+                rain_set_load_level(&rain, 0);
+            shedding = edited.load_shedding && !renderer->offscreen;
+            throttle.budget = edited.output_budget;
+            period_ms = edited.refresh_rate;
+            scheduler_set_period(&scheduler, period_ms);
+            scheduler.policy = edited.frame_policy;
+        }
+    }
 
-    return 0;
+    if (watching)
+        file_watch_free(&watch);
+    event_loop_free(&loop);
+    if (stats_fd >= 0)
+        stats_socket_close(stats_fd, settings.stats_socket);
+    if (exporting)
+        shm_export_close(&shm);
+
+    if (pipelined)
+        render_pipeline_stop(&pipeline);
+    renderer->shutdown();
+    if (record_path && recorder_close(&recorder) != 0)
+        perror(record_path);
+    if (error[0])
+        printf("Error: %s.\n", error);
+
+    front_buffer_free(&front);
+    hud_free(&hud);
+    viewport_free(&view);
+    rain_free(&rain);
+
+    return exit_status;
 }
 
-void handle_winch(int sig)
+void handle_quit(int sig)
 {
-    // Reinitialize or handle resize in a real program.
-    // For simplicity we just call ncurses resize helpers.
-    endwin();
-    refresh();
-    clear();
+    quit_requested = 1;
 }
 
-int init_colors()
+int install_signal_handlers()
 {
-    if (has_colors() == FALSE)
-    {
-        endwin();
-        printf("Your terminal does not support color\n");
-        return 1;
-    }
-
-    if (can_change_color() == FALSE)
-    {
-        endwin();
-        printf("Your terminal does not support changing color\n");
-        return 1;
-    }
-
-    start_color();
-    init_color(COLOR_BLACK, 0, 0, 0);
-    init_color(COLOR_WHITE, 1000, 1000, 1000);
-    init_color(COLOR_BRIGHT_GREEN, 0, 1000, 255);
-    init_color(COLOR_DIMMER_GREEN, 0, 560, 67);
-    init_color(COLOR_DARK_GREEN, 0, 231, 0);
-
-    init_pair(PAIR_WHITE, COLOR_WHITE, COLOR_BLACK);
-    init_pair(PAIR_BRIGHT_GREEN, COLOR_BRIGHT_GREEN, COLOR_BLACK);
-    init_pair(PAIR_DIMMER_GREEN, COLOR_DIMMER_GREEN, COLOR_BLACK);
-    init_pair(PAIR_DARK_GREEN, COLOR_DARK_GREEN, COLOR_BLACK);
-
+    // Playback and broadcasting keep their size; the live animation's event loop takes SIGWINCH over
+    struct sigaction sa = {0};
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGWINCH, &sa, NULL) != 0)
+        return -1;
+
+    sa.sa_handler = handle_quit;
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGINT, &sa, NULL) != 0 || sigaction(SIGTERM, &sa, NULL) != 0)
+        return -1;
     return 0;
 }
 
-wchar_t get_random_symbol()
-{
-    const size_t matrix_symbols_len = wcslen(matrix_symbols);
-    return matrix_symbols[rand() % matrix_symbols_len];
-}
-
-/* Draw a symbol at row,col — width-aware and bounds-guarded.
- * For wide chars we also mark the right half in glyph_matrix by storing the same char
- * in both cells. This keeps later reads consistent.
- * Also checks if drawing a wide char would overwrite revealed message characters.
+/* Follow the terminal to its new size: 1 when the screen was cleared and
+ * everything will be redrawn, 0 when the size could not be read and the old
+ * one stays, -1 when out of memory. With a view (a canvas), only the view
+ * changes size.
  */
-void draw_symbol(int row, int col, wchar_t ch, ColorPair color_pair,
-                 Glyph **glyph_matrix, int max_width, int max_height)
+int apply_resize(const Renderer *renderer, Rain *rain, Viewport *view, FrontBuffer *front)
 {
-    if (row < 0 || row >= max_height || col < 0 || col >= max_width)
-        return;
-
-    if (ch == L' ' || ch == 0)
-        return; // nothing to draw
-
-    const int w = wcwidth(ch);
-    if (w == 2 && col == max_width - 1)
-    {
-        // Can't place wide char at last column
-        return;
-    }
-
-    attron(COLOR_PAIR(color_pair));
-
-    // draw glyph (always write starting at leading cell)
-    wchar_t buf[2] = {ch, L'\0'};
-    mvaddwstr(row, col, buf);
-
-    // mark matrix: store the same wchar in both halves so later reads are sane
-    glyph_matrix[row][col].symbol = ch;
-    glyph_matrix[row][col].color = color_pair;
-    if (w == 2 && col + 1 < max_width)
-    {
-        glyph_matrix[row][col + 1].symbol = ch; // mark trailing cell with same char (occupied)
-        glyph_matrix[row][col + 1].color = color_pair;
-    }
+    int width, height;
+    if (renderer->resize(&width, &height) != 0)
+        return 0;
+
+    if (view ? viewport_resize(view, width, height) != 0 : rain_resize(rain, width, height) != RAIN_OK)
+        return -1;
+    if (front_buffer_resize(front, width, height) != 0)
+        return -1;
+    return 1;
 }
 
-/* Erase symbol at row,col. If the leading char is double-width, erase both halves in one call. */
-void erase_symbol(int row, int col, Glyph **glyph_matrix, int max_width)
+/* Defaults overlaid with settings.ini: 0 when it loaded and validated, <0
+ * when it could not be read, else the line of the first problem.
+ */
+int load_settings(Settings *settings)
 {
-    if (row < 0 || col < 0 || col >= max_width)
-        return;
-
-    wchar_t leading = glyph_matrix[row][col].symbol;
-    if (leading == L' ' || leading == 0)
-    {
-        // nothing there; still ensure we clear the cell
-        mvaddwstr(row, col, L" ");
-        glyph_matrix[row][col].symbol = L' ';
-        return;
-    }
-
-    int w = wcwidth(leading);
-    if (w <= 0)
-        w = 1;
-
-    if (w == 2 && col < max_width - 1)
-    {
-        mvaddwstr(row, col, L"  "); // erase both halves in one call
-        glyph_matrix[row][col].symbol = L' ';
-        glyph_matrix[row][col + 1].symbol = L' ';
-    }
-    else
-    {
-        mvaddwstr(row, col, L" ");
-        glyph_matrix[row][col].symbol = L' ';
-    }
+    settings_defaults(settings);
+    return ini_parse(SETTINGS_PATH, handler, settings);
 }
 
-bool is_message_column(size_t message_len, int column, int *message_columns)
+/* A command line option's whole-string decimal value in [min, max]: 0, or
+ * -1 after saying what the option expects.
+ */
+int parse_option(const char *option, const char *text, long min, long max, long *value)
 {
-    for (int i = 0; i < message_len; i++)
+    char *end;
+    errno = 0;
+    const long n = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || n < min || n > max)
     {
-        if (column == message_columns[i])
-        {
-            return true;
-        }
+        fprintf(stderr, "Error: %s expects a whole number from %ld to %ld\n", option, min, max);
+        return -1;
     }
-    return false;
+    *value = n;
+    return 0;
 }
 
-wchar_t get_message_char(size_t message_len, int column, int *message_columns, const wchar_t *message)
+void print_usage(const char *prog)
 {
-    for (int i = 0; i < message_len; i++)
-    {
-        if (column == message_columns[i])
-        {
-            return message[i];
-        }
-    }
-    return L'\0';
+    printf("Usage: %s [options]\n", prog);
+    printf("  --bench           run the simulation headless and report frame timings\n");
+    printf("  --frames N        number of frames to simulate in bench mode (default 1000); otherwise stop after N\n");
+    printf("  --size WxH        grid size in bench and server mode (default 200x60), and for ppm / y4m output\n");
+    printf("  --seed N          replay the run with this seed (default: settings.ini, else 1 in bench mode)\n");
+    printf("  --paced           in bench mode, sleep between frames at refresh_rate\n");
+    printf("  --microbench      time the hot simulation paths one by one at several sizes\n");
+    printf("  --results FILE    with --microbench, save the results as TSV\n");
+    printf("  --baseline FILE   with --microbench, fail if a metric got slower than in these saved results\n");
+    printf("  --threshold PCT   with --baseline, how much slower counts as a regression (default 25)\n");
+    printf("  --record FILE     save every frame's changes to FILE\n");
+    printf("  --play FILE       play a recording back instead of simulating\n");
+    printf("  --rate MS         with --play, frame period instead of the recorded one\n");
+    printf("  --cast FILE       with --play, convert to an asciicast v2 file instead\n");
+    printf("  --serve ADDR      simulate once and stream it to every client on ADDR (a socket path or HOST:PORT)\n");
+    printf("  --connect ADDR    show the stream of a --serve on this terminal\n");
+    printf("  --renderer NAME   output backend: ncurses (default), ansi, null,\n");
+    printf("                    or ppm / y4m to render video frames to stdout (1920x1080 by default)\n");
+    printf("  -h, --help        show this help\n");
+    printf("Keys while it runs: space or p pauses and resumes, + / - speed up / slow down, q quits\n");
 }
-
-/* Check if drawing a character at row,col would overwrite a revealed message character.
- * This considers that wide characters (wcwidth=2) occupy two columns.
- */
-int would_overwrite_revealed_message(int row, int col, wchar_t ch, int middle_row,
-                                     size_t message_len, int *message_columns, bool *message_revealed)
-{
-    if (row != middle_row)
-        return 0; // Not at message row
-
-    int w = wcwidth(ch);
-    if (w <= 0)
-        w = 1;
-
-    // Check if this character or its wide extension would overwrite a revealed message char
-    for (int offset = 0; offset < w; offset++)
-    {
-        int check_col = col + offset;
-        for (int i = 0; i < message_len; i++)
-        {
-            if (message_columns[i] == check_col && message_revealed[i])
-            {
-                return 1; // Would overwrite a revealed message character
-            }
-        }
-    }
-
-    return 0; // Safe to draw
-}
\ No newline at end of file
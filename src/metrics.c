@@ -0,0 +1,348 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+#define NS_PER_SEC 1000000000LL
+
+// Characters the HUD line is made of: printable ASCII
+#define HUD_FIRST_CHAR '!'
+#define HUD_LAST_CHAR '~'
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+void metrics_init(Metrics *metrics, const Renderer *renderer)
+{
+    *metrics = (Metrics){0};
+    metrics->bytes_known = renderer->bytes_written != NULL;
+    metrics->window_start_ns = now_ns();
+}
+
+void metrics_begin_frame(Metrics *metrics)
+{
+    metrics->frame_start_ns = now_ns();
+}
+
+void metrics_step(Metrics *metrics, const Rain *rain)
+{
+    MetricsCounters *total = &metrics->total;
+    total->steps++;
+    total->spawn_attempts += rain->spawn_attempts;
+    total->spawns += rain->spawns;
+    total->cells_drawn += rain->cells_drawn;
+    total->cells_erased += rain->cells_erased;
+}
+
+static MetricsCounters counters_since(const MetricsCounters *now, const MetricsCounters *then)
+{
+    return (MetricsCounters){
+        .frames = now->frames - then->frames,
+        .steps = now->steps - then->steps,
+        .frame_ns = now->frame_ns - then->frame_ns,
+        .spawn_attempts = now->spawn_attempts - then->spawn_attempts,
+        .spawns = now->spawns - then->spawns,
+        .cells_drawn = now->cells_drawn - then->cells_drawn,
+        .cells_erased = now->cells_erased - then->cells_erased,
+        .cells_changed = now->cells_changed - then->cells_changed,
+        .bytes_written = now->bytes_written - then->bytes_written,
+    };
+}
+
+void metrics_end_frame(Metrics *metrics, const Rain *rain, const FrontBuffer *front, const Renderer *renderer)
+{
+    const int64_t now = now_ns();
+    const uint64_t frame_ns = now - metrics->frame_start_ns;
+    const uint64_t us = frame_ns / 1000;
+
+    // Bucket i holds [2^(i-1), 2^i) microseconds, bucket 0 anything under one
+    int bucket = us ? 64 - __builtin_clzll(us) : 0;
+    if (bucket >= METRICS_BUCKETS)
+        bucket = METRICS_BUCKETS - 1;
+    metrics->frame_buckets[bucket]++;
+    if (frame_ns > metrics->frame_ns_max)
+        metrics->frame_ns_max = frame_ns;
+
+    MetricsCounters *total = &metrics->total;
+    total->frames++;
+    total->frame_ns += frame_ns;
+    total->cells_changed += front->cells_changed;
+    if (metrics->bytes_known)
+        total->bytes_written = renderer->bytes_written();
+    metrics->active_trails = rain->trails.active_count;
+    metrics->max_trails = rain->trails.limit;
+    metrics->load_level = rain->load_level;
+
+    if (now - metrics->window_start_ns >= METRICS_WINDOW_NS)
+    {
+        metrics->last_window = counters_since(total, &metrics->window_start);
+        metrics->last_window_ns = now - metrics->window_start_ns;
+        metrics->window_start = *total;
+        metrics->window_start_ns = now;
+    }
+}
+
+uint64_t metrics_percentile_us(const Metrics *metrics, double fraction)
+{
+    const uint64_t frames = metrics->total.frames;
+    if (frames == 0)
+        return 0;
+
+    const uint64_t wanted = (uint64_t)(fraction * frames + 0.5);
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_BUCKETS - 1; i++)
+    {
+        seen += metrics->frame_buckets[i];
+        if (seen >= wanted)
+            return 1ull << i;
+    }
+    return (metrics->frame_ns_max + 999) / 1000; // Past the last bound only the maximum is known
+}
+
+/* snprintf onto the end of buf; the text is cut short rather than overflowing. */
+static void appendf(char *buf, size_t size, size_t *len, const char *format, ...)
+{
+    if (*len >= size)
+        return;
+    va_list args;
+    va_start(args, format);
+    const int n = vsnprintf(buf + *len, size - *len, format, args);
+    va_end(args);
+    if (n > 0)
+        *len = *len + n < size ? *len + n : size - 1;
+}
+
+/* The stats as one JSON object on a line of its own. */
+static size_t format_json(const Metrics *metrics, char *buf, size_t size)
+{
+    const MetricsCounters *total = &metrics->total;
+    const MetricsCounters *window = &metrics->last_window;
+    const double window_sec = metrics->last_window_ns / (double)NS_PER_SEC;
+    size_t len = 0;
+
+    appendf(buf, size, &len, "{\"frames\":%llu,\"steps\":%llu,",
+            (unsigned long long)total->frames, (unsigned long long)total->steps);
+    appendf(buf, size, &len,
+            "\"frame_us\":{\"mean\":%.1f,\"max\":%.1f,\"p50\":%llu,\"p99\":%llu,\"histogram\":[",
+            total->frames ? total->frame_ns / 1e3 / total->frames : 0.0, metrics->frame_ns_max / 1e3,
+            (unsigned long long)metrics_percentile_us(metrics, 0.50),
+            (unsigned long long)metrics_percentile_us(metrics, 0.99));
+    for (int i = 0; i < METRICS_BUCKETS; i++)
+    {
+        if (i < METRICS_BUCKETS - 1)
+            appendf(buf, size, &len, "{\"lt\":%llu,", 1ull << i);
+        else
+            appendf(buf, size, &len, "{\"lt\":null,");
+        appendf(buf, size, &len, "\"count\":%llu}%s", (unsigned long long)metrics->frame_buckets[i],
+                i < METRICS_BUCKETS - 1 ? "," : "]},");
+    }
+    appendf(buf, size, &len, "\"trails\":{\"active\":%zu,\"max\":%zu},\"load_level\":%d,",
+            metrics->active_trails, metrics->max_trails, metrics->load_level);
+    appendf(buf, size, &len, "\"spawns\":{\"attempts\":%llu,\"successes\":%llu},",
+            (unsigned long long)total->spawn_attempts, (unsigned long long)total->spawns);
+    appendf(buf, size, &len, "\"cells\":{\"drawn\":%llu,\"erased\":%llu,\"changed\":%llu},",
+            (unsigned long long)total->cells_drawn, (unsigned long long)total->cells_erased,
+            (unsigned long long)total->cells_changed);
+    if (metrics->bytes_known)
+        appendf(buf, size, &len, "\"bytes_written\":%llu,", (unsigned long long)total->bytes_written);
+    else
+        appendf(buf, size, &len, "\"bytes_written\":null,");
+    appendf(buf, size, &len, "\"last_second\":{\"seconds\":%.3f,\"fps\":%.1f,\"bytes_per_sec\":%.0f}}\n",
+            window_sec, window_sec > 0 ? window->frames / window_sec : 0.0,
+            window_sec > 0 ? window->bytes_written / window_sec : 0.0);
+    return len;
+}
+
+void hud_init(Hud *hud)
+{
+    *hud = (Hud){.row = -1};
+}
+
+void hud_free(Hud *hud)
+{
+    free(hud->shown);
+    hud_init(hud);
+}
+
+int hud_show(Hud *hud, Palette *palette)
+{
+    wchar_t chars[HUD_LAST_CHAR - HUD_FIRST_CHAR + 2];
+    for (int ch = HUD_FIRST_CHAR; ch <= HUD_LAST_CHAR; ch++)
+        chars[ch - HUD_FIRST_CHAR] = ch;
+    chars[HUD_LAST_CHAR - HUD_FIRST_CHAR + 1] = L'\0';
+
+    const size_t known = palette->count;
+    if (palette_extend(palette, chars) != 0)
+        return -1;
+
+    for (int ch = 0; ch < 128; ch++)
+        hud->glyphs[ch] = ch >= HUD_FIRST_CHAR && ch <= HUD_LAST_CHAR ? palette_lookup(palette, ch) : GLYPH_EMPTY;
+    hud->enabled = true;
+    hud_invalidate(hud);
+    return palette->count != known;
+}
+
+void hud_hide(Hud *hud, FrontBuffer *front, DirtyMap *dirty)
+{
+    if (hud->row >= 0 && hud->row < front->front.height)
+    {
+        front_buffer_invalidate_row(front, hud->row);
+        dirty_map_mark(dirty, hud->row, 0, front->front.width);
+    }
+    hud->enabled = false;
+    hud->row = -1;
+}
+
+void hud_invalidate(Hud *hud)
+{
+    hud->row = -1;
+}
+
+/* The status line: rates over the last complete window, frame times over the whole run. */
+static size_t format_hud(const Metrics *metrics, char *buf, size_t size)
+{
+    const MetricsCounters *window = &metrics->last_window;
+    const double sec = metrics->last_window_ns / (double)NS_PER_SEC;
+    const double frames = window->frames ? (double)window->frames : 1.0;
+    size_t len = 0;
+
+    buf[0] = '\0';
+    appendf(buf, size, &len, "fps %.1f | frame p50<%lluus p99<%lluus max %.2fms | trails %zu/%zu",
+            sec > 0 ? window->frames / sec : 0.0,
+            (unsigned long long)metrics_percentile_us(metrics, 0.50),
+            (unsigned long long)metrics_percentile_us(metrics, 0.99),
+            metrics->frame_ns_max / 1e6, metrics->active_trails, metrics->max_trails);
+    appendf(buf, size, &len, " | spawns %llu/%llu tries | cells +%.0f -%.0f =%.0f/frame",
+            (unsigned long long)window->spawns, (unsigned long long)window->spawn_attempts,
+            window->cells_drawn / frames, window->cells_erased / frames, window->cells_changed / frames);
+    if (metrics->load_level)
+        appendf(buf, size, &len, " | shed %d", metrics->load_level);
+    if (metrics->bytes_known)
+        appendf(buf, size, &len, " | tty %.1fKB/s", sec > 0 ? window->bytes_written / sec / 1024 : 0.0);
+    return len;
+}
+
+int hud_draw(Hud *hud, const Metrics *metrics, FrontBuffer *front)
+{
+    const int row = front->front.height - 1;
+    const int width = front->front.width;
+    if (row < 0)
+        return 0;
+
+    if (hud->row != row || hud->width != width)
+    {
+        // Redraw in full: what the row shows is no longer known
+        uint16_t *shown = realloc(hud->shown, width * sizeof(uint16_t));
+        if (!shown)
+            return -1;
+        hud->shown = shown;
+        hud->width = width;
+        hud->row = row;
+        for (int col = 0; col < width; col++)
+            shown[col] = (uint16_t)~GLYPH_EMPTY;
+    }
+
+    // The rain's writes to the row are kept off the screen; the front copy still follows them
+    DrawList *list = &front->list;
+    while (list->count > 0 && list->ops[list->count - 1].row == row)
+        list->count--;
+    if (draw_list_reserve(list, width) != 0)
+        return -1;
+
+    char text[512];
+    const size_t len = format_hud(metrics, text, sizeof(text));
+
+    for (int col = 0; col < width; col++)
+    {
+        const unsigned char ch = (size_t)col < len ? text[col] : ' ';
+        const uint16_t glyph = ch < 128 ? hud->glyphs[ch] : GLYPH_EMPTY;
+        if (glyph == hud->shown[col])
+            continue;
+        hud->shown[col] = glyph;
+        list->ops[list->count++] = (DrawOp){
+            row, col,
+            glyph,
+            glyph == GLYPH_EMPTY ? 0 : PAIR_WHITE,
+            1,
+        };
+    }
+    return 0;
+}
+
+int stats_socket_open(const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    unlink_stale_socket(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0)
+    {
+        const int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+    return fd;
+}
+
+void unlink_stale_socket(const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    struct stat st;
+    if (strlen(path) >= sizeof(addr.sun_path) || lstat(path, &st) != 0 || !S_ISSOCK(st.st_mode))
+        return;
+    strcpy(addr.sun_path, path);
+
+    // Refused means nobody listens; a server that answers keeps its socket
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return;
+    const bool stale = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno == ECONNREFUSED;
+    close(fd);
+    if (stale)
+        unlink(path);
+}
+
+void stats_socket_close(int fd, const char *path)
+{
+    close(fd);
+    unlink(path);
+}
+
+void stats_socket_serve(int fd, const Metrics *metrics)
+{
+    char json[4096];
+    size_t len = 0;
+    int client;
+    while ((client = accept4(fd, NULL, NULL, SOCK_CLOEXEC)) >= 0)
+    {
+        if (len == 0)
+            len = format_json(metrics, json, sizeof(json));
+        // A few KB fit the socket buffer, so this does not wait on the reader;
+        // one that hung up already costs an error, not a SIGPIPE
+        ssize_t n = send(client, json, len, MSG_NOSIGNAL);
+        (void)n;
+        close(client);
+    }
+}
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "microbench.h"
+#include "rain.h"
+
+// Cells each call to a primitive's probe covers
+#define PROBE_CELLS 16384
+
+// Every metric is the median of this many runs, which shrugs off a run the scheduler got in the way of
+#define REPETITIONS 5
+
+// Each run keeps going until it has taken at least this long; runs of a few microseconds are mostly timer noise
+#define MIN_RUN_NS 50e6
+
+// Frames simulated before timing, so trails and revealed message cells are in place
+#define WARMUP_FRAMES 300
+
+// Metrics timed on each grid and message
+#define METRICS 6
+
+#define MAX_RESULTS 64
+
+static const struct
+{
+    int width;
+    int height;
+} sizes[] = {
+    {80, 24},
+    {200, 60},
+    {1000, 300},
+};
+
+static const int message_lengths[] = {0, 256, MESSAGE_MAX_LENGTH - 1};
+
+typedef struct
+{
+    char name[64];
+    double ns;                // Per operation, the median of runs
+    double runs[REPETITIONS]; // Every run's ns per operation
+    bool gated;               // A regression past the threshold fails the run; otherwise it is only reported
+} Result;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Up to length characters of message, in centered lines of at most 64
+ * columns, as many as fit the grid. The layout refuses a message that
+ * does not fit, so the longest ones come out shorter on small grids.
+ */
+static void build_message(wchar_t *message, int length, int width, int height)
+{
+    static const wchar_t text[] = L"WAKE UP NEO THE MATRIX HAS YOU FOLLOW THE WHITE RABBIT ";
+    const int line_width = width - 2 < 64 ? width - 2 : 64;
+    const int max_lines = height - 2;
+
+    int n = 0, column = 0, lines = 1;
+    for (int i = 0; n < length && n < MESSAGE_MAX_LENGTH - 1; i++)
+    {
+        if (column == line_width)
+        {
+            if (lines == max_lines || n + 1 >= length)
+                break;
+            message[n++] = L'\n';
+            column = 0;
+            lines++;
+            continue;
+        }
+        message[n++] = text[i % (sizeof(text) / sizeof(text[0]) - 1)];
+        column++;
+    }
+    message[n] = L'\0';
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Name the metric and record its run'th run, in ns per operation. */
+static void add_run(Result *result, const char *metric, int width, int height, int message, bool gated, int run,
+                    double ns)
+{
+    snprintf(result->name, sizeof(result->name), "%s/%dx%d/msg%d", metric, width, height, message);
+    result->gated = gated;
+    result->runs[run] = ns;
+}
+
+/* Run every metric once on one grid and message, into the run'th run of the
+ * METRICS results from results on; 0 on success.
+ */
+static int bench_config(const Settings *defaults, int width, int height, int message_length, int run,
+                        Result *results)
+{
+    static Settings settings; // Too big for the stack with the message in it
+    settings = *defaults;
+    settings.threads = 1;
+    settings.seed = 1;
+    build_message(settings.message, message_length, width, height);
+    const int message = (int)wcslen(settings.message);
+
+    Rain rain;
+    const RainStatus status = rain_init(&rain, &settings, width, height);
+    if (status != RAIN_OK)
+    {
+        fprintf(stderr, "Error: %s\n", rain_strerror(status));
+        return 1;
+    }
+    RainProbeCell *cells = malloc(PROBE_CELLS * sizeof(RainProbeCell));
+    if (!cells)
+    {
+        rain_free(&rain);
+        fprintf(stderr, "Error: %s\n", rain_strerror(RAIN_ERR_ALLOC));
+        return 1;
+    }
+
+    for (int f = 0; f < WARMUP_FRAMES; f++)
+        rain_step(&rain);
+
+    // Frames first, while the grid is as the simulation left it
+    long frames = 0;
+    double elapsed;
+    double t0 = now_ns();
+    do
+    {
+        rain_step(&rain);
+        frames++;
+    } while ((elapsed = now_ns() - t0) < MIN_RUN_NS);
+    add_run(&results[5], "frame_step", width, height, message, true, run, elapsed / frames);
+
+    // Spawning takes too little of a frame to time in one piece, so its share is summed
+    double spawn = 0;
+    frames = 0;
+    t0 = now_ns();
+    do
+    {
+        rain_begin_frame(&rain);
+        rain_decay(&rain);
+        rain_update_trails(&rain);
+        rain_overlay_message(&rain);
+        const double t1 = now_ns();
+        rain_spawn_trails(&rain);
+        spawn += now_ns() - t1;
+        frames++;
+    } while (now_ns() - t0 < MIN_RUN_NS);
+    add_run(&results[4], "spawn_trails", width, height, message, false, run, spawn / frames);
+
+    Rng rng;
+    rng_seed(&rng, 1);
+    for (int i = 0; i < PROBE_CELLS; i++)
+    {
+        cells[i].row = (int)rng_below(&rng, height);
+        cells[i].col = (int)rng_below(&rng, width);
+        cells[i].glyph = (uint16_t)(1 + rng_below(&rng, (uint32_t)rain.palette.rain_count));
+    }
+
+    // The sums keep the calls from being optimized away
+    size_t sink = 0;
+    long calls = 0;
+    t0 = now_ns();
+    do
+    {
+        sink += rain_probe_random_symbols(&rain, PROBE_CELLS);
+        calls++;
+    } while ((elapsed = now_ns() - t0) < MIN_RUN_NS);
+    add_run(&results[3], "get_random_symbol", width, height, message, true, run, elapsed / (calls * PROBE_CELLS));
+
+    calls = 0;
+    t0 = now_ns();
+    do
+    {
+        sink += rain_probe_would_overwrite(&rain, cells, PROBE_CELLS);
+        calls++;
+    } while ((elapsed = now_ns() - t0) < MIN_RUN_NS);
+    add_run(&results[2], "would_overwrite_revealed_message", width, height, message, true, run,
+            elapsed / (calls * PROBE_CELLS));
+
+    // Drawing and erasing take turns, so every erase finds the cells drawn
+    double draw = 0, erase = 0;
+    calls = 0;
+    do
+    {
+        const double t1 = now_ns();
+        sink += rain_probe_draw(&rain, cells, PROBE_CELLS);
+        const double t2 = now_ns();
+        sink += rain_probe_erase(&rain, cells, PROBE_CELLS);
+        draw += t2 - t1;
+        erase += now_ns() - t2;
+        calls++;
+    } while (draw < MIN_RUN_NS || erase < MIN_RUN_NS);
+    add_run(&results[0], "draw_symbol", width, height, message, true, run, draw / (calls * PROBE_CELLS));
+    add_run(&results[1], "erase_symbol", width, height, message, true, run, erase / (calls * PROBE_CELLS));
+    if (sink == 0)
+        fprintf(stderr, "microbench: no cells touched\n");
+
+    free(cells);
+    rain_free(&rain);
+    return 0;
+}
+
+/* Read results written by an earlier run: "name<TAB>ns" lines, '#' comments. */
+static int load_baseline(const char *path, Result *baseline, int *count)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return -1;
+
+    char line[128];
+    *count = 0;
+    while (*count < MAX_RESULTS && fgets(line, sizeof(line), file))
+    {
+        Result *result = &baseline[*count];
+        if (line[0] != '#' && sscanf(line, "%63s %lf", result->name, &result->ns) == 2)
+            (*count)++;
+    }
+    fclose(file);
+    return 0;
+}
+
+static int save_results(const char *path, const Result *results, int count)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+        return -1;
+
+    fprintf(file, "# metric\tns_per_op\n");
+    for (int i = 0; i < count; i++)
+        fprintf(file, "%s\t%.3f\n", results[i].name, results[i].ns);
+    return fclose(file);
+}
+
+int microbench_run(const Settings *settings, const MicrobenchOptions *options)
+{
+    Result results[MAX_RESULTS];
+    int count = 0;
+
+    // Every configuration runs once before any runs again, so a slow spell hits one run of a metric, not all of them
+    for (int run = 0; run < REPETITIONS; run++)
+    {
+        count = 0;
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            for (size_t m = 0; m < sizeof(message_lengths) / sizeof(message_lengths[0]); m++)
+            {
+                if (bench_config(settings, sizes[s].width, sizes[s].height, message_lengths[m], run,
+                                 &results[count]) != 0)
+                    return 1;
+                count += METRICS;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++)
+    {
+        qsort(results[i].runs, REPETITIONS, sizeof(double), compare_doubles);
+        results[i].ns = results[i].runs[REPETITIONS / 2];
+    }
+
+    Result baseline[MAX_RESULTS];
+    int baseline_count = 0;
+    if (options->baseline && load_baseline(options->baseline, baseline, &baseline_count) != 0)
+    {
+        printf("microbench: no baseline at %s, nothing to compare\n", options->baseline);
+        baseline_count = 0;
+    }
+
+    int regressions = 0;
+    printf("%-52s %12s %12s %8s\n", "metric", "ns/op", "baseline", "change");
+    for (int i = 0; i < count; i++)
+    {
+        const Result *before = NULL;
+        for (int j = 0; j < baseline_count && !before; j++)
+        {
+            if (strcmp(baseline[j].name, results[i].name) == 0)
+                before = &baseline[j];
+        }
+
+        if (!before || before->ns <= 0)
+        {
+            printf("%-52s %12.2f %12s %8s\n", results[i].name, results[i].ns, "-", "-");
+            continue;
+        }
+        const double change = (results[i].ns / before->ns - 1) * 100;
+        const bool regressed = change > options->threshold;
+        regressions += regressed && results[i].gated;
+        printf("%-52s %12.2f %12.2f %+7.1f%%%s\n", results[i].name, results[i].ns, before->ns, change,
+               !regressed ? "" : results[i].gated ? "  REGRESSED" : "  (not gated)");
+    }
+
+    if (options->results && save_results(options->results, results, count) != 0)
+    {
+        perror(options->results);
+        return 1;
+    }
+    if (regressions)
+    {
+        printf("microbench: %d metric%s regressed by more than %d%%\n", regressions, regressions == 1 ? "" : "s",
+               options->threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "palette.h"
+
+// The original four colors, which COLORS_BASIC keeps
+static const uint8_t basic_rgb[][3] = {
+    {255, 255, 255}, // Head
+    {0, 255, 65},
+    {0, 143, 17},
+    {0, 59, 0},
+};
+
+// Head, then the greens of the xterm color cube from brightest to darkest
+static const uint8_t xterm_ramp[] = {231, 120, 47, 46, 41, 40, 35, 34, 29, 28, 22};
+
+// Points the truecolor ramp after the head passes through, evenly spaced
+static const uint8_t truecolor_fade[][3] = {{0, 255, 65}, {0, 143, 17}, {0, 59, 0}, {0, 24, 0}};
+
+#define TRUECOLOR_SHADES PALETTE_MAX_SHADES
+
+static void add_symbol(Palette *palette, wchar_t ch)
+{
+    const size_t index = palette->count++;
+    palette->symbols[index] = ch;
+
+    const int w = wcwidth(ch);
+    palette->widths[index] = w == 2 ? 2 : 1;
+    if (w == 2)
+        palette->all_narrow = false;
+
+    char buf[MB_LEN_MAX];
+    mbstate_t state;
+    memset(&state, 0, sizeof(state));
+    size_t len = wcrtomb(buf, ch, &state);
+    if (len == (size_t)-1 || len > GLYPH_MAX_ENCODED)
+    {
+        // Not representable in this locale; show a placeholder rather than garbage
+        buf[0] = '?';
+        len = 1;
+    }
+    memcpy(palette->encoded[index], buf, len);
+    palette->encoded_len[index] = (uint8_t)len;
+}
+
+int palette_init(Palette *palette, const wchar_t *rain_symbols, const wchar_t *message)
+{
+    *palette = (Palette){0};
+
+    const size_t capacity = 1 + wcslen(rain_symbols) + wcslen(message);
+    if (capacity > UINT16_MAX)
+        return -1;
+
+    palette->symbols = malloc(capacity * sizeof(wchar_t));
+    palette->widths = malloc(capacity * sizeof(uint8_t));
+    palette->encoded = malloc(capacity * sizeof(*palette->encoded));
+    palette->encoded_len = malloc(capacity * sizeof(uint8_t));
+    if (!palette->symbols || !palette->widths || !palette->encoded || !palette->encoded_len)
+    {
+        palette_free(palette);
+        return -1;
+    }
+
+    palette->all_narrow = true;
+    add_symbol(palette, L' ');
+    palette_set_colors(palette, COLORS_BASIC);
+
+    for (const wchar_t *p = rain_symbols; *p; p++)
+    {
+        if (*p != L' ' && palette_lookup(palette, *p) == GLYPH_EMPTY)
+            add_symbol(palette, *p);
+    }
+    palette->rain_count = palette->count - 1;
+    if (palette->rain_count == 0)
+    {
+        palette_free(palette);
+        return -1;
+    }
+
+    for (const wchar_t *p = message; *p; p++)
+    {
+        if (*p != L'\n' && *p != L' ' && palette_lookup(palette, *p) == GLYPH_EMPTY)
+            add_symbol(palette, *p);
+    }
+
+    return 0;
+}
+
+int palette_extend(Palette *palette, const wchar_t *message)
+{
+    size_t missing = 0;
+    for (const wchar_t *p = message; *p; p++)
+    {
+        if (*p != L'\n' && *p != L' ' && palette_lookup(palette, *p) == GLYPH_EMPTY)
+            missing++; // Repeats are counted more than once; that only over-allocates
+    }
+    if (missing == 0)
+        return 0;
+
+    const size_t capacity = palette->count + missing;
+    if (capacity > UINT16_MAX)
+        return -1;
+
+    wchar_t *symbols = realloc(palette->symbols, capacity * sizeof(wchar_t));
+    if (symbols)
+        palette->symbols = symbols;
+    uint8_t *widths = realloc(palette->widths, capacity * sizeof(uint8_t));
+    if (widths)
+        palette->widths = widths;
+    char(*encoded)[GLYPH_MAX_ENCODED] = realloc(palette->encoded, capacity * sizeof(*palette->encoded));
+    if (encoded)
+        palette->encoded = encoded;
+    uint8_t *encoded_len = realloc(palette->encoded_len, capacity * sizeof(uint8_t));
+    if (encoded_len)
+        palette->encoded_len = encoded_len;
+    if (!symbols || !widths || !encoded || !encoded_len)
+        return -1;
+
+    for (const wchar_t *p = message; *p; p++)
+    {
+        if (*p != L'\n' && *p != L' ' && palette_lookup(palette, *p) == GLYPH_EMPTY)
+            add_symbol(palette, *p);
+    }
+    return 0;
+}
+
+/* The color of xterm 256-color index n (16..255). */
+static void xterm_rgb(uint8_t n, uint8_t rgb[3])
+{
+    static const uint8_t levels[] = {0, 95, 135, 175, 215, 255};
+    if (n >= 232)
+    {
+        rgb[0] = rgb[1] = rgb[2] = (uint8_t)(8 + (n - 232) * 10);
+        return;
+    }
+    n -= 16;
+    rgb[0] = levels[n / 36];
+    rgb[1] = levels[n / 6 % 6];
+    rgb[2] = levels[n % 6];
+}
+
+void palette_set_colors(Palette *palette, ColorMode mode)
+{
+    palette->color_mode = mode;
+    memset(palette->shade_rgb, 0, sizeof(palette->shade_rgb));
+    memset(palette->shade_xterm, 0, sizeof(palette->shade_xterm));
+
+    switch (mode)
+    {
+    case COLORS_256:
+        palette->shade_count = sizeof(xterm_ramp);
+        for (int i = 0; i < palette->shade_count; i++)
+        {
+            palette->shade_xterm[i + 1] = xterm_ramp[i];
+            xterm_rgb(xterm_ramp[i], palette->shade_rgb[i + 1]);
+        }
+        break;
+    case COLORS_TRUECOLOR:
+        // White, then the basic greens stretched out and fading on towards black
+        palette->shade_count = TRUECOLOR_SHADES;
+        memcpy(palette->shade_rgb[1], basic_rgb[0], 3);
+        for (int i = 2; i <= TRUECOLOR_SHADES; i++)
+        {
+            const int segments = sizeof(truecolor_fade) / sizeof(truecolor_fade[0]) - 1;
+            int t = (i - 2) * segments * 256 / (TRUECOLOR_SHADES - 2); // 8 fraction bits
+            if (t == segments * 256)
+                t--;
+            const uint8_t *from = truecolor_fade[t >> 8];
+            const uint8_t *to = truecolor_fade[(t >> 8) + 1];
+            for (int c = 0; c < 3; c++)
+                palette->shade_rgb[i][c] = (uint8_t)(from[c] + (to[c] - from[c]) * (t & 255) / 255);
+        }
+        break;
+    default:
+        palette->color_mode = COLORS_BASIC;
+        palette->shade_count = sizeof(basic_rgb) / sizeof(basic_rgb[0]);
+        memcpy(palette->shade_rgb[1], basic_rgb, sizeof(basic_rgb));
+        break;
+    }
+}
+
+void palette_free(Palette *palette)
+{
+    free(palette->symbols);
+    free(palette->widths);
+    free(palette->encoded);
+    free(palette->encoded_len);
+    *palette = (Palette){0};
+}
+
+uint16_t palette_lookup(const Palette *palette, wchar_t ch)
+{
+    for (size_t i = 1; i < palette->count; i++)
+    {
+        if (palette->symbols[i] == ch)
+            return (uint16_t)i;
+    }
+    return GLYPH_EMPTY;
+}
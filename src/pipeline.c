@@ -0,0 +1,88 @@
+#include <stdlib.h>
+
+#include "pipeline.h"
+
+static void *render_main(void *arg)
+{
+    RenderPipeline *pipeline = arg;
+
+    pthread_mutex_lock(&pipeline->lock);
+    while (1)
+    {
+        while (!pipeline->has_pending && !pipeline->stop)
+            pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+        if (!pipeline->has_pending)
+            break;
+
+        const DrawList frame = pipeline->pending;
+        pipeline->pending = pipeline->presenting;
+        pipeline->presenting = frame;
+        pipeline->has_pending = false;
+        pipeline->busy = true;
+        pthread_cond_broadcast(&pipeline->cond);
+        pthread_mutex_unlock(&pipeline->lock);
+
+        pipeline->renderer->present(&pipeline->presenting, pipeline->palette);
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->busy = false;
+        pthread_cond_broadcast(&pipeline->cond);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return NULL;
+}
+
+int render_pipeline_start(RenderPipeline *pipeline, const Renderer *renderer, const Palette *palette)
+{
+    *pipeline = (RenderPipeline){0};
+    pipeline->renderer = renderer;
+    pipeline->palette = palette;
+    pthread_mutex_init(&pipeline->lock, NULL);
+    pthread_cond_init(&pipeline->cond, NULL);
+
+    if (pthread_create(&pipeline->thread, NULL, render_main, pipeline) != 0)
+    {
+        pthread_cond_destroy(&pipeline->cond);
+        pthread_mutex_destroy(&pipeline->lock);
+        return -1;
+    }
+    return 0;
+}
+
+void render_pipeline_stop(RenderPipeline *pipeline)
+{
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->stop = true;
+    pthread_cond_broadcast(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->lock);
+    pthread_join(pipeline->thread, NULL);
+
+    pthread_cond_destroy(&pipeline->cond);
+    pthread_mutex_destroy(&pipeline->lock);
+    free(pipeline->pending.ops);
+    free(pipeline->presenting.ops);
+    *pipeline = (RenderPipeline){0};
+}
+
+void render_pipeline_submit(RenderPipeline *pipeline, DrawList *list)
+{
+    pthread_mutex_lock(&pipeline->lock);
+    while (pipeline->has_pending)
+        pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+
+    const DrawList frame = *list;
+    *list = pipeline->pending;
+    list->count = 0;
+    pipeline->pending = frame;
+    pipeline->has_pending = true;
+    pthread_cond_broadcast(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+void render_pipeline_sync(RenderPipeline *pipeline)
+{
+    pthread_mutex_lock(&pipeline->lock);
+    while (pipeline->has_pending || pipeline->busy)
+        pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+    pthread_mutex_unlock(&pipeline->lock);
+}
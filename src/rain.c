@@ -0,0 +1,1632 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "rain.h"
+
+/* Helpers on the per-cell path take a `wide` flag that is a compile-time
+ * constant in each specialization of the trail update, so the narrow-only
+ * build of the loop carries no width handling at all.
+ */
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+static inline uint16_t get_random_symbol(const Rain *rain, RainBand *band);
+ALWAYS_INLINE void draw_symbol(Rain *rain, RainBand *band, int row, int col, uint16_t glyph, ColorPair color_pair,
+                               uint8_t fade, uint8_t bucket, const bool wide);
+ALWAYS_INLINE void erase_symbol(Rain *rain, RainBand *band, int row, int col, const bool wide);
+ALWAYS_INLINE int would_overwrite_revealed_message(const Rain *rain, int row, int col, uint16_t glyph, const bool wide);
+static void update_trails_narrow(Rain *rain, RainBand *band);
+static void update_trails_wide(Rain *rain, RainBand *band);
+
+static int trail_pool_reserve(TrailPool *pool, size_t limit);
+
+static int trail_pool_init(TrailPool *pool, size_t capacity)
+{
+    *pool = (TrailPool){0};
+    return trail_pool_reserve(pool, capacity);
+}
+
+/* Raise the spawn limit, growing the arrays if it exceeds the capacity. Lowering it never shrinks them. */
+static int trail_pool_reserve(TrailPool *pool, size_t limit)
+{
+    pool->limit = limit;
+    if (limit <= pool->capacity)
+        return 0;
+
+    int *column = realloc(pool->column, limit * sizeof(int));
+    if (column)
+        pool->column = column;
+    int *head_row = realloc(pool->head_row, limit * sizeof(int));
+    if (head_row)
+        pool->head_row = head_row;
+    int *length = realloc(pool->length, limit * sizeof(int));
+    if (length)
+        pool->length = length;
+    uint32_t *free_slots = realloc(pool->free_slots, limit * sizeof(uint32_t));
+    if (free_slots)
+        pool->free_slots = free_slots;
+    if (!column || !head_row || !length || !free_slots)
+        return -1;
+
+    // New slots go under the existing free ones; pop order hands out the lowest first
+    memmove(pool->free_slots + (limit - pool->capacity), pool->free_slots, pool->free_count * sizeof(uint32_t));
+    for (size_t i = 0; i < limit - pool->capacity; i++)
+        pool->free_slots[i] = (uint32_t)(limit - 1 - i);
+    pool->free_count += limit - pool->capacity;
+    pool->capacity = limit;
+    return 0;
+}
+
+static void trail_pool_free(TrailPool *pool)
+{
+    free(pool->column);
+    free(pool->head_row);
+    free(pool->length);
+    free(pool->free_slots);
+    *pool = (TrailPool){0};
+}
+
+static void free_bands(RainBand *bands, int band_count)
+{
+    for (int b = 0; b < band_count; b++)
+    {
+        for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+            free(bands[b].active[k]);
+        free(bands[b].retired);
+        free(bands[b].new_reveals);
+        free(bands[b].tiles);
+        if (band_count > 1)
+            free(bands[b].dirty.spans); // A lone band borrows Rain.dirty's spans
+    }
+    free(bands);
+}
+
+/* Split the columns into bands, at most one per worker thread, and hand
+ * every live trail to the band of its column. Called again after a resize.
+ */
+static int layout_bands(Rain *rain)
+{
+    const int chunks = (rain->width + RAIN_BAND_ALIGN - 1) / RAIN_BAND_ALIGN;
+    const int threads = rain->workers.count;
+    const int band_cols = (chunks + threads - 1) / threads * RAIN_BAND_ALIGN;
+    const int band_count = (rain->width + band_cols - 1) / band_cols;
+    const size_t capacity = rain->trails.capacity;
+
+    RainBand *bands = calloc(band_count, sizeof(RainBand));
+    if (!bands)
+        return -1;
+
+    for (int b = 0; b < band_count; b++)
+    {
+        RainBand *band = &bands[b];
+        band->col_lo = b * band_cols;
+        band->col_hi = band->col_lo + band_cols < rain->width ? band->col_lo + band_cols : rain->width;
+        for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+            band->active[k] = malloc(capacity * sizeof(uint32_t));
+        band->retired = malloc(capacity * sizeof(uint32_t));
+        band->new_reveals = malloc((rain->message_len + 1) * sizeof(uint32_t));
+        if (rain->tile_live)
+        {
+            const int tile_cols = (band->col_hi - band->col_lo + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE;
+            band->tiles = malloc((size_t)rain->grid.tiles_y * tile_cols * sizeof(uint32_t));
+        }
+        rng_seed(&band->rng, rng_next(&rain->rng));
+
+        band->dirty = rain->dirty;
+        if (band_count > 1)
+        {
+            band->dirty.spans = malloc(rain->height * sizeof(DirtySpan));
+            if (band->dirty.spans)
+            {
+                for (int row = 0; row < rain->height; row++)
+                    band->dirty.spans[row] = (DirtySpan){rain->width, 0};
+            }
+        }
+
+        bool active_ok = true;
+        for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+            active_ok = active_ok && band->active[k];
+        if (!active_ok || !band->retired || !band->new_reveals || !band->dirty.spans || (rain->tile_live && !band->tiles))
+        {
+            free_bands(bands, b + 1);
+            return -1;
+        }
+    }
+
+    for (int b = 0; b < rain->band_count; b++)
+    {
+        const RainBand *old = &rain->bands[b];
+        for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+        {
+            for (size_t i = 0; i < old->active_count[k]; i++)
+            {
+                const uint32_t slot = old->active[k][i];
+                RainBand *band = &bands[rain->trails.column[slot] / band_cols];
+                band->active[k][band->active_count[k]++] = slot;
+            }
+        }
+    }
+
+    // The tiles in use go to the band of their columns
+    const size_t tiles = (size_t)rain->grid.tiles_x * rain->grid.tiles_y;
+    for (size_t tile = 0; rain->tile_live && tile < tiles; tile++)
+    {
+        if (!rain->tile_live[tile])
+            continue;
+        RainBand *band = &bands[(int)(tile % rain->grid.tiles_x) * GRID_TILE_SIZE / band_cols];
+        band->tiles[band->tile_count++] = (uint32_t)tile;
+    }
+
+    free_bands(rain->bands, rain->band_count);
+    rain->bands = bands;
+    rain->band_count = band_count;
+    rain->band_cols = band_cols;
+    return 0;
+}
+
+/* Start a trail at the top of column, at a speed drawn from the buckets in
+ * use. The caller checks that a slot is free.
+ */
+static void spawn_trail(Rain *rain, int column)
+{
+    TrailPool *pool = &rain->trails;
+    RainBand *band = &rain->bands[column / rain->band_cols];
+    const uint32_t slot = pool->free_slots[--pool->free_count];
+    const int bucket = rain->speed_buckets > 1 ? (int)rng_below(&rain->rng, (uint32_t)rain->speed_buckets) : 0;
+
+    pool->column[slot] = column;
+    pool->head_row[slot] = 0;
+    pool->length[slot] = rain->max_trail_length;
+    band->active[bucket][band->active_count[bucket]++] = slot;
+    pool->active_count++;
+    rain->spawns++;
+}
+
+/* Fold what the bands recorded during the trail update into the Rain. */
+static void gather_bands(Rain *rain)
+{
+    TrailPool *pool = &rain->trails;
+    pool->active_count = 0;
+
+    for (int b = 0; b < rain->band_count; b++)
+    {
+        RainBand *band = &rain->bands[b];
+
+        memcpy(pool->free_slots + pool->free_count, band->retired, band->retired_count * sizeof(uint32_t));
+        pool->free_count += band->retired_count;
+        band->retired_count = 0;
+        for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+            pool->active_count += band->active_count[k];
+
+        memcpy(rain->new_reveals + rain->new_reveal_count, band->new_reveals,
+               band->new_reveal_count * sizeof(uint32_t));
+        rain->new_reveal_count += band->new_reveal_count;
+        band->new_reveal_count = 0;
+
+        rain->cells_drawn += band->cells_drawn;
+        band->cells_drawn = 0;
+        rain->cells_erased += band->cells_erased;
+        band->cells_erased = 0;
+
+        if (band->dirty.spans == rain->dirty.spans)
+            continue;
+        for (int row = 0; row < rain->height; row++)
+        {
+            DirtySpan *span = &band->dirty.spans[row];
+            if (span->lo >= span->hi)
+                continue;
+            dirty_map_mark_span(&rain->dirty, row, span->lo, span->hi);
+            *span = (DirtySpan){rain->width, 0};
+        }
+    }
+}
+
+/* Index into message_cells for row,col, or -1 when the cell is not part of the message. */
+static inline int message_cell_at(const Rain *rain, int row, int col)
+{
+    return rain->message_index[(size_t)row * rain->width + col] - 1;
+}
+
+/* Words per row of revealed_bits. Rows are padded to whole words so that
+ * bands, which start on a word boundary, never share one.
+ */
+static inline size_t revealed_words_per_row(int width)
+{
+    return ((size_t)width + 63) / 64;
+}
+
+static inline bool is_revealed(const Rain *rain, int row, int col)
+{
+    const size_t word = (size_t)row * revealed_words_per_row(rain->width) + col / 64;
+    return (rain->revealed_bits[word] >> (col % 64)) & 1;
+}
+
+static inline void set_revealed(Rain *rain, int row, int col)
+{
+    const size_t word = (size_t)row * revealed_words_per_row(rain->width) + col / 64;
+    rain->revealed_bits[word] |= (uint64_t)1 << (col % 64);
+}
+
+/* Where the fade byte of row,col is in a fade array for grid: tiled like a
+ * tiled grid, so a tile's fade bytes are one page of their own.
+ */
+static inline size_t fade_index(const Grid *grid, int row, int col)
+{
+    if (grid->layout == GRID_TILED)
+        return grid_index(grid, row, col);
+    return (size_t)row * grid->width + col;
+}
+
+static inline uint8_t *fade_at(const Rain *rain, int row, int col)
+{
+    return &rain->fade[fade_index(&rain->grid, row, col)];
+}
+
+static inline uint8_t *fade_bucket_at(const Rain *rain, int row, int col)
+{
+    return &rain->fade_bucket[fade_index(&rain->grid, row, col)];
+}
+
+static uint8_t *alloc_fade(const Grid *grid)
+{
+    return grid->layout == GRID_TILED ? grid_reserve(grid->cells) : calloc(grid->cells, sizeof(uint8_t));
+}
+
+static void free_fade(uint8_t *fade, const Grid *grid)
+{
+    if (grid->layout == GRID_TILED)
+        grid_unreserve(fade, grid->cells);
+    else
+        free(fade);
+}
+
+/* The shade of a trail cell `rows` behind the head, for max_trail_length and the palette. */
+static int shade_after(const Rain *rain, int rows)
+{
+    const int length = rain->max_trail_length;
+    if (rows == 0)
+        return PAIR_WHITE;
+    if (rain->palette.color_mode == COLORS_BASIC)
+    {
+        // The original offsets: bright behind the head, dimmer from halfway, dark from three quarters
+        if (rows < length / 2 + 1)
+            return PAIR_BRIGHT_GREEN;
+        if (rows < (length / 4) * 3 + 1)
+            return rain->shade_step > 1 ? PAIR_BRIGHT_GREEN : PAIR_DIMMER_GREEN;
+        return PAIR_DARK_GREEN;
+    }
+    const int step = rain->shade_step;
+    return 2 + ((rows - 1) * (rain->palette.shade_count - 1) / length) / step * step;
+}
+
+/* Rows a trail of the bucket moves in frames, give or take its phase. */
+static int rows_after(const Rain *rain, int bucket, int frames)
+{
+    return (int)(((uint64_t)frames * rain->bucket_speed[bucket]) >> RAIN_SPEED_SHIFT);
+}
+
+/* Work out how long a trail cell keeps each shade and which one follows, by
+ * walking the life of a cell in the longest trail of each speed bucket,
+ * frame by frame, as the head moves away from it. A shade held for more
+ * than 255 frames moves on after 255. Cells left on a shade the walk skips
+ * (the shade step went up, or the trail gets past it within a frame) move
+ * on to the next one it visits.
+ */
+static void build_fade_table(Rain *rain)
+{
+    memset(rain->shade_frames, 0, sizeof(rain->shade_frames));
+    memset(rain->next_shade, 0, sizeof(rain->next_shade));
+
+    const int length = rain->max_trail_length;
+    for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+    {
+        uint8_t *shade_frames = rain->shade_frames[k];
+        uint8_t *next_shade = rain->next_shade[k];
+        bool visited[PALETTE_MAX_SHADES + 1] = {false};
+        int frames = 0;
+        while (rows_after(rain, k, frames) < length)
+        {
+            const int shade = shade_after(rain, rows_after(rain, k, frames));
+            const int start = frames;
+            visited[shade] = true;
+            while (rows_after(rain, k, frames) < length && shade_after(rain, rows_after(rain, k, frames)) == shade)
+                frames++;
+            if (rows_after(rain, k, frames) >= length)
+                break; // The last shade lasts until the tail erases the cell
+
+            shade_frames[shade] = (uint8_t)(frames - start < 255 ? frames - start : 255);
+            next_shade[shade] = (uint8_t)shade_after(rain, rows_after(rain, k, frames));
+        }
+
+        int following = 0;
+        for (int shade = rain->palette.shade_count; shade > PAIR_WHITE; shade--)
+        {
+            if (visited[shade])
+                following = shade;
+            else
+                next_shade[shade] = (uint8_t)following;
+        }
+    }
+}
+
+// What each load level keeps: the percentage of the random trails that start, and every how many shades one is used
+static const struct
+{
+    int density;
+    int shade_step;
+} load_levels[RAIN_LOAD_LEVELS] = {
+    {100, 1},
+    {70, 2},
+    {50, 4},
+    {35, 8},
+    {25, PALETTE_MAX_SHADES},
+};
+
+// spawn_rate is in hundredths of a trail and trail_density in percent
+#define SPAWN_CREDIT_UNIT 10000
+
+static void update_spawn_rate(Rain *rain)
+{
+    rain->spawn_rate = (int)(rain->spawn_density * rain->width + 0.5);
+}
+
+/* Spread the bucket speeds evenly from min_speed to max_speed. Buckets keep
+ * their trails, so a change only alters how fast those move from now on.
+ */
+static void set_speeds(Rain *rain, const Settings *settings)
+{
+    const double lo = settings->min_speed < settings->max_speed ? settings->min_speed : settings->max_speed;
+    const double hi = settings->min_speed < settings->max_speed ? settings->max_speed : settings->min_speed;
+
+    rain->speed_buckets = hi > lo ? RAIN_SPEED_BUCKETS : 1;
+    for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+    {
+        const double speed = lo + (hi - lo) * k / (RAIN_SPEED_BUCKETS - 1);
+        const uint32_t fixed = (uint32_t)(speed * (1 << RAIN_SPEED_SHIFT) + 0.5);
+        rain->bucket_speed[k] = fixed > 0 ? fixed : 1;
+    }
+}
+
+static void set_flicker(Rain *rain, const Settings *settings)
+{
+    const double rate = settings->flicker_rate / 100;
+    rain->flicker_scale = rate <= 0 ? 0 : rate >= 1 ? -0.0 : 1 / log1p(-rate);
+    rain->flicker_budget = rate > 0 ? settings->flicker_budget : 0;
+}
+
+static const wchar_t *default_symbols = L"日ﾊﾐﾋｰｳｼﾅﾓﾆｻﾜﾂｵﾘｱﾎﾃﾏｹﾒｴｶｷﾑﾕﾗｾﾈｽﾀﾇﾍ012345789Z:・.=*+-<>¦｜╌";
+
+static void measure_message(const wchar_t *message, size_t *cells, int *lines, int *longest_line)
+{
+    int line_len = 0;
+    *cells = 0;
+    *lines = 1;
+    *longest_line = 0;
+    for (const wchar_t *p = message; *p; p++)
+    {
+        if (*p == L'\n')
+        {
+            (*lines)++;
+            line_len = 0;
+            continue;
+        }
+        (*cells)++;
+        if (++line_len > *longest_line)
+            *longest_line = line_len;
+    }
+}
+
+/* Lay the message out as centered lines, the block centered on the middle
+ * row. Characters that fall outside the grid are hidden (row -1). Only the
+ * message's own entries of message_index are written; the rest must be 0.
+ */
+static void layout_message(Rain *rain)
+{
+    const int width = rain->width;
+    const int height = rain->height;
+
+    size_t cells;
+    int lines, longest_line;
+    measure_message(rain->message, &cells, &lines, &longest_line);
+
+    int row = height / 2 - lines / 2;
+    const wchar_t *line = rain->message;
+    size_t index = 0;
+    while (1)
+    {
+        const wchar_t *line_end = wcschr(line, L'\n');
+        const int len = line_end ? (int)(line_end - line) : (int)wcslen(line);
+        const int leftmost_column = (int)(width / 2) - (int)(len / 2);
+
+        for (int i = 0; i < len; i++)
+        {
+            MessageCell *cell = &rain->message_cells[index];
+            cell->row = row;
+            cell->col = leftmost_column + i;
+            cell->glyph = palette_lookup(&rain->palette, line[i]);
+            if (row >= 0 && row < height && cell->col >= 0 && cell->col < width)
+                rain->message_index[(size_t)row * width + cell->col] = (int)index + 1;
+            else
+                cell->row = -1;
+            index++;
+        }
+
+        if (!line_end)
+            break;
+        line = line_end + 1;
+        row++;
+    }
+}
+
+RainStatus rain_init(Rain *rain, const Settings *settings, int width, int height)
+{
+    *rain = (Rain){0};
+
+    rain->width = width;
+    rain->height = height;
+    rain->max_trail_length = settings->max_trail_length;
+    rain->message_spawn_frame_interval = settings->message_spawn_frame_interval; // Spawn a message trail every n frames
+    rain->spawn_density = settings->spawn_density;
+    update_spawn_rate(rain);
+    set_speeds(rain, settings);
+    set_flicker(rain, settings);
+    rain->trail_density = load_levels[0].density;
+    rain->shade_step = load_levels[0].shade_step;
+    rng_seed(&rain->rng, settings->seed);
+
+    size_t message_len;
+    int lines, longest_line;
+    measure_message(settings->message, &message_len, &lines, &longest_line);
+    if (longest_line > width)
+        return RAIN_ERR_MESSAGE_WIDTH;
+    if (lines > height)
+        return RAIN_ERR_MESSAGE_HEIGHT;
+
+    const size_t cells = (size_t)width * height;
+    const GridLayout layout =
+        settings->canvas_width || settings->canvas_height ? GRID_TILED : (GridLayout)settings->grid_layout;
+    rain->message_len = message_len;
+    rain->message = malloc((wcslen(settings->message) + 1) * sizeof(wchar_t));
+    rain->message_cells = malloc((message_len + 1) * sizeof(MessageCell));
+    rain->message_revealed = calloc(message_len + 1, sizeof(bool)); // Initially no characters are revealed
+    rain->message_index = calloc(cells, sizeof(int));
+    rain->revealed_bits = calloc(revealed_words_per_row(width) * height, sizeof(uint64_t));
+    if (!rain->message || !rain->message_cells || !rain->message_revealed || !rain->message_index ||
+        !rain->revealed_bits)
+    {
+        rain_free(rain);
+        return RAIN_ERR_ALLOC;
+    }
+    wcscpy(rain->message, settings->message);
+
+    const wchar_t *symbols = settings->symbols[0] ? settings->symbols : default_symbols;
+    if (palette_init(&rain->palette, symbols, settings->message) != 0 ||
+        grid_init(&rain->grid, width, height, layout) != 0 || !(rain->fade = alloc_fade(&rain->grid)) ||
+        !(rain->fade_bucket = alloc_fade(&rain->grid)) ||
+        (layout == GRID_TILED &&
+         !(rain->tile_live = calloc((size_t)rain->grid.tiles_x * rain->grid.tiles_y, sizeof(uint8_t)))))
+    {
+        rain_free(rain);
+        return RAIN_ERR_ALLOC;
+    }
+    palette_set_colors(&rain->palette, (ColorMode)settings->colors);
+    build_fade_table(rain);
+
+    // Pick the trail update once; with only narrow glyphs it skips all width handling
+    rain->update_trails = rain->palette.all_narrow ? update_trails_narrow : update_trails_wide;
+
+    layout_message(rain);
+
+    const size_t max_trails = width + width * (height / settings->max_trail_length);
+
+    rain->new_reveals = malloc((rain->message_len + 1) * sizeof(uint32_t));
+
+    if (trail_pool_init(&rain->trails, max_trails) != 0 || dirty_map_init(&rain->dirty, width, height) != 0 ||
+        !(rain->top_occupied = calloc(rain->dirty.words_per_row, sizeof(uint64_t))) ||
+        !(rain->spawnable = calloc(rain->dirty.words_per_row, sizeof(uint64_t))) || !rain->new_reveals || worker_pool_init(&rain->workers, settings->threads) != 0 || layout_bands(rain) != 0)
+    {
+        rain_free(rain);
+        return RAIN_ERR_ALLOC;
+    }
+
+    return RAIN_OK;
+}
+
+void rain_free(Rain *rain)
+{
+    worker_pool_free(&rain->workers);
+    free_bands(rain->bands, rain->band_count);
+    free_fade(rain->fade, &rain->grid);
+    free_fade(rain->fade_bucket, &rain->grid);
+    grid_free(&rain->grid);
+    palette_free(&rain->palette);
+    trail_pool_free(&rain->trails);
+    dirty_map_free(&rain->dirty);
+    free(rain->new_reveals);
+    free(rain->message);
+    free(rain->message_cells);
+    free(rain->message_revealed);
+    free(rain->message_index);
+    free(rain->revealed_bits);
+    free(rain->tile_live);
+    free(rain->top_occupied);
+    free(rain->spawnable);
+    *rain = (Rain){0};
+}
+
+/* Take the revealed message off the grid, both halves of a wide character. */
+static void lift_message(Rain *rain)
+{
+    Grid *grid = &rain->grid;
+    for (size_t i = 0; i < rain->message_len; i++)
+    {
+        const MessageCell *cell = &rain->message_cells[i];
+        if (!rain->message_revealed[i] || cell->row < 0)
+            continue;
+
+        const size_t index = grid_index(grid, cell->row, cell->col);
+        const int cells = (grid->color[index] & CELL_WIDE) && cell->col + 1 < rain->width ? 2 : 1;
+        for (int c = 0; c < cells; c++)
+        {
+            const size_t at = grid_index(grid, cell->row, cell->col + c);
+            grid->glyph[at] = GLYPH_EMPTY;
+            grid->color[at] = 0;
+        }
+        dirty_map_mark(&rain->dirty, cell->row, cell->col, cell->col + cells);
+    }
+}
+
+/* Clear the message's entries of message_index and revealed_bits, leaving
+ * the rest of either untouched: they may be far bigger than the message.
+ */
+static void forget_message(Rain *rain)
+{
+    for (size_t i = 0; i < rain->message_len; i++)
+    {
+        const MessageCell *cell = &rain->message_cells[i];
+        if (cell->row < 0)
+            continue;
+        rain->message_index[(size_t)cell->row * rain->width + cell->col] = 0;
+        const size_t word = (size_t)cell->row * revealed_words_per_row(rain->width) + cell->col / 64;
+        rain->revealed_bits[word] &= ~((uint64_t)1 << (cell->col % 64));
+    }
+}
+
+/* Swap in a new message, all of it hidden again. The palette only grows, so
+ * glyphs already on the grid keep their meaning.
+ */
+static RainStatus replace_message(Rain *rain, const wchar_t *message)
+{
+    size_t message_len;
+    int lines, longest_line;
+    measure_message(message, &message_len, &lines, &longest_line);
+
+    wchar_t *copy = malloc((wcslen(message) + 1) * sizeof(wchar_t));
+    MessageCell *cells = malloc((message_len + 1) * sizeof(MessageCell));
+    bool *revealed = calloc(message_len + 1, sizeof(bool));
+    uint32_t *new_reveals = malloc((message_len + 1) * sizeof(uint32_t));
+    if (!copy || !cells || !revealed || !new_reveals || palette_extend(&rain->palette, message) != 0)
+    {
+        free(copy);
+        free(cells);
+        free(revealed);
+        free(new_reveals);
+        return RAIN_ERR_ALLOC;
+    }
+    wcscpy(copy, message);
+
+    lift_message(rain);
+    forget_message(rain);
+
+    free(rain->message);
+    free(rain->message_cells);
+    free(rain->message_revealed);
+    free(rain->new_reveals);
+    rain->message = copy;
+    rain->message_cells = cells;
+    rain->message_revealed = revealed;
+    rain->new_reveals = new_reveals;
+    rain->new_reveal_count = 0;
+    rain->message_len = message_len;
+
+    layout_message(rain);
+    rain->update_trails = rain->palette.all_narrow ? update_trails_narrow : update_trails_wide;
+
+    // The bands' reveal lists are sized by the message
+    return layout_bands(rain) == 0 ? RAIN_OK : RAIN_ERR_ALLOC;
+}
+
+RainStatus rain_apply_settings(Rain *rain, const Settings *settings)
+{
+    rain->message_spawn_frame_interval = settings->message_spawn_frame_interval;
+    rain->spawn_density = settings->spawn_density;
+    update_spawn_rate(rain);
+    set_speeds(rain, settings);
+    set_flicker(rain, settings);
+
+    // New speeds or a new length: cells on screen finish their current shade first
+    const int max_trail_length = rain->max_trail_length;
+    rain->max_trail_length = settings->max_trail_length;
+    build_fade_table(rain);
+
+    if (settings->max_trail_length != max_trail_length)
+    {
+
+        // Live trails keep their length; the limit follows the new one
+        const size_t capacity = rain->trails.capacity;
+        const size_t max_trails = rain->width + rain->width * (rain->height / rain->max_trail_length);
+        if (trail_pool_reserve(&rain->trails, max_trails) != 0)
+            return RAIN_ERR_ALLOC;
+        if (rain->trails.capacity != capacity && layout_bands(rain) != 0)
+            return RAIN_ERR_ALLOC;
+    }
+
+    if (wcscmp(settings->message, rain->message) != 0)
+        return replace_message(rain, settings->message);
+    return RAIN_OK;
+}
+
+void rain_set_load_level(Rain *rain, int level)
+{
+    if (level < 0)
+        level = 0;
+    if (level >= RAIN_LOAD_LEVELS)
+        level = RAIN_LOAD_LEVELS - 1;
+
+    rain->load_level = level;
+    rain->trail_density = load_levels[level].density;
+    if (load_levels[level].shade_step != rain->shade_step)
+    {
+        rain->shade_step = load_levels[level].shade_step;
+        build_fade_table(rain);
+    }
+}
+
+RainStatus rain_resize(Rain *rain, int width, int height)
+{
+    Grid *old = &rain->grid;
+
+    // Lift the revealed message off the grid; it is drawn again at its new position
+    lift_message(rain);
+
+    Grid grid;
+    DirtyMap dirty;
+    const size_t cells = (size_t)width * height;
+    int *message_index = realloc(rain->message_index, cells * sizeof(int));
+    if (message_index)
+    {
+        rain->message_index = message_index;
+        memset(message_index, 0, cells * sizeof(int)); // layout_message() only writes the message's cells
+    }
+    const size_t revealed_words = revealed_words_per_row(width) * height;
+    uint64_t *revealed_bits = realloc(rain->revealed_bits, revealed_words * sizeof(uint64_t));
+    if (revealed_bits)
+        rain->revealed_bits = revealed_bits;
+    if (!message_index || !revealed_bits || grid_init(&grid, width, height, old->layout) != 0)
+        return RAIN_ERR_ALLOC;
+    uint8_t *fade = alloc_fade(&grid);
+    uint8_t *fade_bucket = alloc_fade(&grid);
+    const size_t tiles = (size_t)grid.tiles_x * grid.tiles_y;
+    uint8_t *tile_live = grid.layout == GRID_TILED ? calloc(tiles, sizeof(uint8_t)) : NULL;
+    if (!fade || !fade_bucket || (grid.layout == GRID_TILED && !tile_live) ||
+        dirty_map_init(&dirty, width, height) != 0)
+    {
+        free_fade(fade, &grid);
+        free_fade(fade_bucket, &grid);
+        free(tile_live);
+        grid_free(&grid);
+        return RAIN_ERR_ALLOC;
+    }
+    uint64_t *top_occupied = realloc(rain->top_occupied, dirty.words_per_row * sizeof(uint64_t));
+    if (top_occupied)
+        rain->top_occupied = top_occupied;
+    uint64_t *spawnable = realloc(rain->spawnable, dirty.words_per_row * sizeof(uint64_t));
+    if (spawnable)
+        rain->spawnable = spawnable;
+    if (!top_occupied || !spawnable)
+    {
+        free_fade(fade, &grid);
+        free_fade(fade_bucket, &grid);
+        free(tile_live);
+        grid_free(&grid);
+        dirty_map_free(&dirty);
+        return RAIN_ERR_ALLOC;
+    }
+    // Every cell is marked dirty below, so the next spawn finds the columns again
+    memset(rain->top_occupied, 0, dirty.words_per_row * sizeof(uint64_t));
+
+    const size_t max_trails = width + width * (height / rain->max_trail_length);
+    if (trail_pool_reserve(&rain->trails, max_trails) != 0)
+    {
+        free_fade(fade, &grid);
+        free_fade(fade_bucket, &grid);
+        free(tile_live);
+        grid_free(&grid);
+        dirty_map_free(&dirty);
+        return RAIN_ERR_ALLOC;
+    }
+
+    // Keep the part of the old grid that still fits; blank cells are left alone, so a tiled grid only gets the tiles in use
+    const int keep_rows = height < old->height ? height : old->height;
+    const int keep_cols = width < old->width ? width : old->width;
+    for (int row = 0; row < keep_rows; row++)
+    {
+        for (int col = 0; col < keep_cols; col++)
+        {
+            const size_t from = grid_index(old, row, col);
+            if (old->glyph[from] == GLYPH_EMPTY && old->color[from] == 0)
+                continue;
+            const size_t to = grid_index(&grid, row, col);
+            grid.glyph[to] = old->glyph[from];
+            grid.color[to] = old->color[from];
+            fade[fade_index(&grid, row, col)] = *fade_at(rain, row, col);
+            fade_bucket[fade_index(&grid, row, col)] = *fade_bucket_at(rain, row, col);
+            if (tile_live)
+                tile_live[grid_tile(&grid, row, col)] = 1;
+        }
+
+        // A wide glyph cut in half by the new right edge goes
+        const size_t edge = grid_index(&grid, row, keep_cols - 1);
+        if (grid.color[edge] & CELL_WIDE)
+        {
+            grid.glyph[edge] = GLYPH_EMPTY;
+            grid.color[edge] = 0;
+            fade[fade_index(&grid, row, keep_cols - 1)] = 0;
+        }
+    }
+
+    free_fade(rain->fade, old);
+    free_fade(rain->fade_bucket, old);
+    grid_free(old);
+    rain->fade = fade;
+    rain->fade_bucket = fade_bucket;
+    free(rain->tile_live);
+    rain->tile_live = tile_live;
+    dirty_map_free(&rain->dirty);
+    rain->grid = grid;
+    rain->dirty = dirty;
+    rain->width = width;
+    rain->height = height;
+    update_spawn_rate(rain);
+
+    // Retire trails whose column is gone
+    TrailPool *pool = &rain->trails;
+    for (int b = 0; b < rain->band_count; b++)
+    {
+        RainBand *band = &rain->bands[b];
+        for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+        {
+            size_t kept = 0;
+            for (size_t i = 0; i < band->active_count[k]; i++)
+            {
+                const uint32_t slot = band->active[k][i];
+                if (pool->column[slot] < width)
+                    band->active[k][kept++] = slot;
+                else
+                    pool->free_slots[pool->free_count++] = slot;
+            }
+            pool->active_count -= band->active_count[k] - kept;
+            band->active_count[k] = kept;
+        }
+    }
+    if (layout_bands(rain) != 0)
+        return RAIN_ERR_ALLOC;
+
+    memset(rain->revealed_bits, 0, revealed_words * sizeof(uint64_t));
+    layout_message(rain);
+
+    rain->new_reveal_count = 0;
+    for (size_t i = 0; i < rain->message_len; i++)
+    {
+        const MessageCell *cell = &rain->message_cells[i];
+        if (rain->message_revealed[i] && cell->row >= 0)
+        {
+            set_revealed(rain, cell->row, cell->col);
+            rain->new_reveals[rain->new_reveal_count++] = (uint32_t)i;
+        }
+    }
+
+    // The screen was cleared, so everything on the grid has to go out again
+    for (int row = 0; row < height; row++)
+        dirty_map_mark(&rain->dirty, row, 0, width);
+
+    return RAIN_OK;
+}
+
+size_t rain_grid_bytes(const Rain *rain)
+{
+    if (rain->grid.layout != GRID_TILED)
+        return grid_bytes(&rain->grid) + 2 * rain->grid.cells; // And a fade and a bucket byte per cell
+
+    size_t tiles = 0;
+    for (int b = 0; b < rain->band_count; b++)
+        tiles += rain->bands[b].tile_count;
+    return tiles * GRID_TILE_CELLS * (sizeof(uint16_t) + 3 * sizeof(uint8_t));
+}
+
+bool rain_message_center(const Rain *rain, int *row, int *col)
+{
+    int top = rain->height, bottom = -1, left = rain->width, right = -1;
+    for (size_t i = 0; i < rain->message_len; i++)
+    {
+        const MessageCell *cell = &rain->message_cells[i];
+        if (cell->row < 0)
+            continue;
+        top = cell->row < top ? cell->row : top;
+        bottom = cell->row > bottom ? cell->row : bottom;
+        left = cell->col < left ? cell->col : left;
+        right = cell->col > right ? cell->col : right;
+    }
+    if (bottom < 0)
+        return false;
+
+    *row = (top + bottom) / 2;
+    *col = (left + right) / 2;
+    return true;
+}
+
+const char *rain_strerror(RainStatus status)
+{
+    switch (status)
+    {
+    case RAIN_OK:
+        return "no error";
+    case RAIN_ERR_ALLOC:
+        return "out of memory";
+    case RAIN_ERR_MESSAGE_WIDTH:
+        return "message exceeds terminal width";
+    case RAIN_ERR_MESSAGE_HEIGHT:
+        return "message has more lines than the terminal";
+    }
+    return "unknown error";
+}
+
+void rain_begin_frame(Rain *rain)
+{
+    rain->cells_drawn = 0;
+    rain->cells_erased = 0;
+    rain->spawn_attempts = 0;
+    rain->spawns = 0;
+}
+
+typedef void (*BandWork)(Rain *rain, RainBand *band);
+
+typedef struct
+{
+    Rain *rain;
+    BandWork work;
+    int first;  // Band the first worker takes
+    int stride; // Distance between the bands of one pass
+} BandPass;
+
+static void run_band_pass(void *ctx, int index, int count)
+{
+    const BandPass *pass = ctx;
+    Rain *rain = pass->rain;
+
+    for (int b = pass->first + index * pass->stride; b < rain->band_count; b += count * pass->stride)
+        pass->work(rain, &rain->bands[b]);
+}
+
+/* Run work on every band, on as many threads as there are bands. */
+static void run_bands(Rain *rain, BandWork work)
+{
+    if (rain->band_count == 1)
+    {
+        work(rain, &rain->bands[0]);
+    }
+    else if (rain->palette.all_narrow)
+    {
+        // A narrow glyph never leaves its column, so every band can run at once
+        BandPass all = {rain, work, 0, 1};
+        worker_pool_run(&rain->workers, run_band_pass, &all);
+    }
+    else
+    {
+        // Writing a wide glyph touches a column on either side: bands that
+        // run together must not be neighbours, so even bands go first
+        BandPass even = {rain, work, 0, 2};
+        BandPass odd = {rain, work, 1, 2};
+        worker_pool_run(&rain->workers, run_band_pass, &even);
+        worker_pool_run(&rain->workers, run_band_pass, &odd);
+    }
+}
+
+// Fade bytes handled at once: a generic vector the compiler maps to SSE2/NEON or splits up
+#define FADE_LANES 16
+typedef uint8_t FadeVector __attribute__((vector_size(FADE_LANES)));
+
+/* Move the glyph whose leading cell is at row,col on to its next shade. */
+static void fade_cell(Rain *rain, RainBand *band, int row, int col)
+{
+    Grid *grid = &rain->grid;
+    const size_t cell = grid_index(grid, row, col);
+    const uint8_t color = grid->color[cell];
+    const uint8_t bucket = *fade_bucket_at(rain, row, col);
+    const uint8_t shade = rain->next_shade[bucket][color & CELL_COLOR_MASK];
+    if (shade == 0)
+        return; // max_trail_length changed under it and this is now the last shade
+
+    int hi = col + 1;
+    grid->color[cell] = (color & ~CELL_COLOR_MASK) | shade;
+    if (color & CELL_WIDE)
+    {
+        grid->color[grid_index(grid, row, col + 1)] = shade | CELL_CONT;
+        hi++;
+    }
+    *fade_at(rain, row, col) = rain->shade_frames[bucket][shade];
+    dirty_map_mark(&band->dirty, row, col, hi);
+    band->cells_drawn += hi - col;
+}
+
+/* Count down the fade bytes of row's columns [lo, hi), which start at
+ * fades, a vector at a time: every byte above 0 drops by one, with no branch
+ * per cell, and only the few cells that reach 0 are looked at further. Only
+ * the leading cell of a glyph has a fade byte; fading a wide one also
+ * recolors its right half, which may lie in the next band.
+ */
+ALWAYS_INLINE void decay_run(Rain *rain, RainBand *band, uint8_t *fades, int row, int lo, int hi)
+{
+    const int count = hi - lo;
+    int i = 0;
+
+    for (; i + FADE_LANES <= count; i += FADE_LANES)
+    {
+        uint64_t words[FADE_LANES / 8];
+        memcpy(words, fades + i, sizeof(words));
+        if (!(words[0] | words[1]))
+            continue;
+
+        FadeVector v;
+        memcpy(&v, words, sizeof(v));
+        const FadeVector expiring = (FadeVector)(v == 1);
+        v += (FadeVector)(v != 0); // Adds 255, i.e. takes one, in every lane that is counting
+        memcpy(fades + i, &v, sizeof(v));
+
+        memcpy(words, &expiring, sizeof(words));
+        if (!(words[0] | words[1]))
+            continue;
+        for (int k = 0; k < FADE_LANES; k++)
+        {
+            if (expiring[k])
+                fade_cell(rain, band, row, lo + i + k);
+        }
+    }
+
+    for (; i < count; i++)
+    {
+        if (fades[i] && --fades[i] == 0)
+            fade_cell(rain, band, row, lo + i);
+    }
+}
+
+static void decay_band(Rain *rain, RainBand *band)
+{
+    const int width = rain->width;
+    for (int row = 0; row < rain->height; row++)
+        decay_run(rain, band, rain->fade + (size_t)row * width + band->col_lo, row, band->col_lo, band->col_hi);
+}
+
+// Frames between two looks at whether a tile went blank; each frame looks at a different share of the tiles
+#define TILE_SWEEP_FRAMES 32
+
+static bool tile_is_blank(const Grid *grid, size_t tile)
+{
+    const uint64_t *glyphs = (const uint64_t *)(grid->glyph + tile * GRID_TILE_CELLS);
+    const uint64_t *colors = (const uint64_t *)(grid->color + tile * GRID_TILE_CELLS);
+    uint64_t any = 0;
+    for (size_t i = 0; i < GRID_TILE_CELLS * sizeof(uint16_t) / sizeof(uint64_t); i++)
+        any |= glyphs[i];
+    for (size_t i = 0; i < GRID_TILE_CELLS / sizeof(uint64_t); i++)
+        any |= colors[i];
+    return any == 0;
+}
+
+/* decay_band() on a tiled grid, over the band's tiles in use only: a tile's
+ * fade bytes are one block, a row of the tile after another. A tile found
+ * blank on its sweep frame gives its pages back and leaves the list until
+ * something is drawn in it again.
+ */
+static void decay_band_tiled(Rain *rain, RainBand *band)
+{
+    Grid *grid = &rain->grid;
+    size_t i = 0;
+
+    while (i < band->tile_count)
+    {
+        const uint32_t tile = band->tiles[i];
+        uint8_t *fades = rain->fade + (size_t)tile * GRID_TILE_CELLS;
+        const int row = (int)(tile / grid->tiles_x) * GRID_TILE_SIZE;
+        const int col = (int)(tile % grid->tiles_x) * GRID_TILE_SIZE;
+        for (int r = 0; r < GRID_TILE_SIZE; r++)
+            decay_run(rain, band, fades + r * GRID_TILE_SIZE, row + r, col, col + GRID_TILE_SIZE);
+
+        if ((rain->frame_counter + tile) % TILE_SWEEP_FRAMES == 0 && tile_is_blank(grid, tile))
+        {
+            grid_release_tile(grid, tile);
+            grid_release(fades, GRID_TILE_CELLS); // Blank cells never fade, so these are all 0
+            grid_release(rain->fade_bucket + (size_t)tile * GRID_TILE_CELLS, GRID_TILE_CELLS);
+            rain->tile_live[tile] = 0;
+            band->tiles[i] = band->tiles[--band->tile_count];
+            continue;
+        }
+        i++;
+    }
+}
+
+void rain_decay(Rain *rain)
+{
+    // What the bands record is folded in by rain_update_trails(), which always follows
+    run_bands(rain, rain->grid.layout == GRID_TILED ? decay_band_tiled : decay_band);
+}
+
+void rain_update_trails(Rain *rain)
+{
+    // Every bucket's share of this frame, taken once so all bands agree on it
+    for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+    {
+        const uint32_t phase = rain->bucket_phase[k] + rain->bucket_speed[k];
+        rain->bucket_steps[k] = (int)(phase >> RAIN_SPEED_SHIFT);
+        rain->bucket_phase[k] = phase & ((1u << RAIN_SPEED_SHIFT) - 1);
+    }
+    run_bands(rain, rain->update_trails);
+    gather_bands(rain);
+}
+
+/* Move one trail of the speed bucket down a row: draw or reveal at the
+ * head, erase past the tail. Returns false once the tail has left the grid and the trail retired.
+ */
+ALWAYS_INLINE bool advance_trail(Rain *rain, RainBand *band, uint32_t slot, int bucket, const bool wide)
+{
+    const int height = rain->height;
+
+    TrailPool *pool = &rain->trails;
+    const int head_row = pool->head_row[slot];
+    const int column = pool->column[slot];
+
+    /* HEAD - reveal message character if head passes over it */
+    if (head_row >= 0 && head_row < height)
+    {
+        const int message_index = message_cell_at(rain, head_row, column);
+        if (message_index >= 0)
+        {
+            // Reveal the message character at this position; rain_overlay_message() draws it
+            if (!is_revealed(rain, head_row, column))
+            {
+                set_revealed(rain, head_row, column);
+                rain->message_revealed[message_index] = true;
+                band->new_reveals[band->new_reveal_count++] = (uint32_t)message_index;
+            }
+        }
+        else
+        {
+            uint16_t glyph = get_random_symbol(rain, band);
+            // Check if this character would overwrite revealed message characters
+            if (!would_overwrite_revealed_message(rain, head_row, column, glyph, wide))
+            {
+                draw_symbol(rain, band, head_row, column, glyph, PAIR_WHITE, rain->shade_frames[bucket][PAIR_WHITE],
+                            (uint8_t)bucket, wide);
+            }
+        }
+    }
+
+    // The body darkens in rain_decay(); the tail is erased here since only the trail knows its length
+    const int tail_row = head_row - pool->length[slot];
+
+    // Don't erase revealed message characters
+    if (tail_row >= 0 && tail_row < height && !is_revealed(rain, tail_row, column))
+    {
+        erase_symbol(rain, band, tail_row, column, wide);
+    }
+
+    if (tail_row >= height)
+    {
+        band->retired[band->retired_count++] = slot;
+        return false;
+    }
+
+    pool->head_row[slot] = head_row + 1;
+    return true;
+}
+
+/* Cells to pass over before the next flicker: geometric with the flicker
+ * rate, by inverting its distribution at a uniform draw in (0, 1].
+ */
+static int64_t flicker_gap(const Rain *rain, RainBand *band)
+{
+    const double u = ((rng_next(&band->rng) >> 11) + 1) * 0x1p-53;
+    const double gap = log(u) * rain->flicker_scale;
+    return gap < (double)INT32_MAX ? (int64_t)gap : INT32_MAX;
+}
+
+/* Give the glyph whose leading cell is at row,col a new symbol, keeping its
+ * shade and fade. Revealed message cells, halves of wide glyphs and draws
+ * that would change a glyph's width are left alone.
+ */
+ALWAYS_INLINE void flicker_cell(Rain *rain, RainBand *band, int row, int col, const bool wide)
+{
+    Grid *grid = &rain->grid;
+    const size_t cell = grid_index(grid, row, col);
+    const uint8_t color = grid->color[cell];
+    if (grid->glyph[cell] == GLYPH_EMPTY || (color & CELL_CONT) || is_revealed(rain, row, col))
+        return;
+
+    const uint16_t glyph = get_random_symbol(rain, band);
+    const int w = wide && (color & CELL_WIDE) ? 2 : 1;
+    if (wide && palette_width(&rain->palette, glyph) != w)
+        return;
+
+    grid->glyph[cell] = glyph;
+    if (w == 2)
+        grid->glyph[grid_index(grid, row, col + 1)] = glyph;
+    dirty_map_mark(&band->dirty, row, col, col + w);
+    band->cells_drawn += w;
+}
+
+/* Flicker the band's trail bodies, taken one after another as a single run
+ * of cells: the walk jumps from one chosen cell to the next, so a frame costs
+ * a step per trail and per change, however many cells the trails cover. The
+ * band gets its share of the budget by width, thinned under load like the
+ * spawning; the gap left over carries into the next frame.
+ */
+ALWAYS_INLINE void flicker_trails(Rain *rain, RainBand *band, const bool wide)
+{
+    if (rain->flicker_budget == 0)
+        return;
+
+    const TrailPool *pool = &rain->trails;
+    const int height = rain->height;
+    const int64_t share = (int64_t)rain->flicker_budget * (band->col_hi - band->col_lo) * rain->trail_density;
+    int64_t budget = (share + (int64_t)rain->width * 100 - 1) / ((int64_t)rain->width * 100);
+    int64_t skip = band->flicker_skip;
+
+    for (int k = 0; k < RAIN_SPEED_BUCKETS && budget > 0; k++)
+    {
+        for (size_t i = 0; i < band->active_count[k] && budget > 0; i++)
+        {
+            // The body: below the tail erased last, above the head drawn last
+            const uint32_t slot = band->active[k][i];
+            const int head_row = pool->head_row[slot] - 1;
+            const int lo = head_row - pool->length[slot] + 1 > 0 ? head_row - pool->length[slot] + 1 : 0;
+            const int hi = head_row < height ? head_row : height;
+            const int span = hi - lo;
+            if (span <= 0)
+                continue;
+
+            for (; skip < span && budget > 0; budget--)
+            {
+                flicker_cell(rain, band, lo + (int)skip, pool->column[slot], wide);
+                skip += 1 + flicker_gap(rain, band);
+            }
+            skip -= span;
+        }
+    }
+    band->flicker_skip = skip > 0 ? skip : 0;
+}
+
+ALWAYS_INLINE void update_trails(Rain *rain, RainBand *band, const bool wide)
+{
+    for (int k = 0; k < RAIN_SPEED_BUCKETS; k++)
+    {
+        // A bucket that doesn't reach the next row this frame is skipped whole
+        const int steps = rain->bucket_steps[k];
+        if (steps == 0)
+            continue;
+
+        uint32_t *active = band->active[k];
+        size_t kept = 0;
+        for (size_t i = 0; i < band->active_count[k]; i++)
+        {
+            const uint32_t slot = active[i];
+            int step = 0;
+            while (step < steps && advance_trail(rain, band, slot, k, wide))
+                step++;
+
+            // A retired trail is dropped; the active list is compacted in place, keeping spawn order
+            if (step == steps)
+                active[kept++] = slot;
+        }
+        band->active_count[k] = kept;
+    }
+
+    flicker_trails(rain, band, wide);
+}
+
+static void update_trails_narrow(Rain *rain, RainBand *band)
+{
+    update_trails(rain, band, false);
+}
+
+static void update_trails_wide(Rain *rain, RainBand *band)
+{
+    update_trails(rain, band, true);
+}
+
+void rain_overlay_message(Rain *rain)
+{
+    const bool wide = !rain->palette.all_narrow;
+
+    // Runs on one thread after the bands are gathered, so it writes the Rain's own dirty map
+    RainBand whole = {.col_lo = 0, .col_hi = rain->width, .dirty = rain->dirty};
+
+    // Draw the characters revealed this frame. Nothing overwrites a revealed
+    // cell afterwards, so earlier ones are still on screen.
+    for (size_t i = 0; i < rain->new_reveal_count; i++)
+    {
+        const MessageCell *cell = &rain->message_cells[rain->new_reveals[i]];
+        draw_symbol(rain, &whole, cell->row, cell->col, cell->glyph, PAIR_WHITE, 0, 0, wide); // Never fades
+    }
+    rain->new_reveal_count = 0;
+    rain->cells_drawn += whole.cells_drawn;
+}
+
+/* Bring top_occupied up to date with the top row cells written since the
+ * last diff, which the dirty map still lists.
+ */
+static void refresh_top_row(Rain *rain)
+{
+    const Grid *grid = &rain->grid;
+    const uint64_t *dirty = rain->dirty.bits; // Row 0
+
+    for (size_t w = 0; w < rain->dirty.words_per_row; w++)
+    {
+        for (uint64_t bits = dirty[w]; bits; bits &= bits - 1)
+        {
+            const int col = (int)(w * 64) + __builtin_ctzll(bits);
+            const uint64_t bit = (uint64_t)1 << (col % 64);
+            if (grid->glyph[grid_index(grid, 0, col)] != GLYPH_EMPTY)
+                rain->top_occupied[w] |= bit;
+            else
+                rain->top_occupied[w] &= ~bit;
+        }
+    }
+}
+
+/* Fill spawnable with the columns that are blank on the top row and so are
+ * both neighbours, so a new trail neither starts on nor beside another one
+ * (a wide glyph's right half counts as occupied). Returns how many there are.
+ */
+static size_t find_spawnable(Rain *rain)
+{
+    const uint64_t *occupied = rain->top_occupied;
+    const size_t words = rain->dirty.words_per_row;
+    size_t count = 0;
+
+    for (size_t w = 0; w < words; w++)
+    {
+        // Bit c of the left / right shift is column c's left / right neighbour
+        const uint64_t left = (occupied[w] << 1) | (w > 0 ? occupied[w - 1] >> 63 : 0);
+        const uint64_t right = (occupied[w] >> 1) | (w + 1 < words ? occupied[w + 1] << 63 : 0);
+        uint64_t free = ~(occupied[w] | left | right);
+
+        const int past_end = (int)((w + 1) * 64) - rain->width;
+        if (past_end > 0)
+            free &= ~(uint64_t)0 >> past_end;
+        rain->spawnable[w] = free;
+        count += __builtin_popcountll(free);
+    }
+    return count;
+}
+
+static inline bool is_spawnable(const Rain *rain, int column)
+{
+    return (rain->spawnable[column / 64] >> (column % 64)) & 1;
+}
+
+/* The index-th spawnable column, counting from the left. */
+static int nth_spawnable(const Rain *rain, size_t index)
+{
+    size_t w = 0;
+    for (size_t bits; index >= (bits = __builtin_popcountll(rain->spawnable[w])); w++)
+        index -= bits;
+
+    uint64_t free = rain->spawnable[w];
+    for (; index > 0; index--)
+        free &= free - 1;
+    return (int)(w * 64) + __builtin_ctzll(free);
+}
+
+/* A trail starts in column: it and its neighbours stop being spawnable.
+ * Returns how many columns that took off.
+ */
+static size_t claim_column(Rain *rain, int column)
+{
+    size_t taken = 0;
+    const int lo = column > 0 ? column - 1 : 0;
+    const int hi = column < rain->width - 1 ? column + 1 : column;
+    for (int col = lo; col <= hi; col++)
+    {
+        const uint64_t bit = (uint64_t)1 << (col % 64);
+        taken += (rain->spawnable[col / 64] & bit) != 0;
+        rain->spawnable[col / 64] &= ~bit;
+    }
+    return taken;
+}
+
+void rain_spawn_trails(Rain *rain)
+{
+    TrailPool *pool = &rain->trails;
+
+    // Every frame, while the dirty map still holds this frame's writes
+    refresh_top_row(rain);
+
+    // Smart trail spawning - prioritize unrevealed message columns
+    rain->frame_counter++;
+    const int should_spawn_message_trail =
+        (rain->frame_counter - rain->last_message_spawn_frame) >= rain->message_spawn_frame_interval;
+
+    // Add new trails if space available
+    if (pool->active_count >= pool->limit || pool->free_count == 0)
+        return;
+
+    size_t spawnable = find_spawnable(rain);
+
+    // First priority: spawn a trail in an unrevealed message column if it's time
+    if (should_spawn_message_trail)
+    {
+        for (size_t msg_idx = 0; msg_idx < rain->message_len; msg_idx++)
+        {
+            const MessageCell *cell = &rain->message_cells[msg_idx];
+            if (!rain->message_revealed[msg_idx] && cell->row >= 0)
+            {
+                int msg_col = cell->col;
+                // Check if this column is available for a new trail
+                rain->spawn_attempts++;
+                if (is_spawnable(rain, msg_col))
+                {
+                    spawn_trail(rain, msg_col);
+                    spawnable -= claim_column(rain, msg_col);
+                    rain->last_message_spawn_frame = rain->frame_counter;
+                    break; // Only spawn one message trail at a time
+                }
+            }
+        }
+    }
+
+    // spawn_density trails per 100 columns, fewer under load; see rain_set_load_level()
+    rain->spawn_credit += rain->spawn_rate * rain->trail_density;
+    int due = rain->spawn_credit / SPAWN_CREDIT_UNIT;
+    rain->spawn_credit %= SPAWN_CREDIT_UNIT; // Trails that found no room are not owed later
+
+    // Second priority: random trails, each in a column drawn from the spawnable ones
+    for (; due > 0 && spawnable > 0 && pool->active_count < pool->limit && pool->free_count > 0; due--)
+    {
+        const int column = nth_spawnable(rain, rng_below(&rain->rng, (uint32_t)spawnable));
+        rain->spawn_attempts++;
+        spawn_trail(rain, column);
+        spawnable -= claim_column(rain, column);
+    }
+}
+
+void rain_step(Rain *rain)
+{
+    rain_begin_frame(rain);
+    rain_decay(rain);
+    rain_update_trails(rain);
+    rain_overlay_message(rain);
+    rain_spawn_trails(rain);
+}
+
+/* Refill the band's symbol batch, four symbols from each 64-bit draw: every
+ * 16-bit quarter is scaled to 1..rain_count by multiply-shift.
+ */
+static void refill_symbols(const Rain *rain, RainBand *band)
+{
+    const uint32_t count = (uint32_t)rain->palette.rain_count;
+    for (int i = 0; i < RAIN_SYMBOL_BATCH; i += 4)
+    {
+        uint64_t bits = rng_next(&band->rng);
+        for (int j = 0; j < 4; j++, bits >>= 16)
+            band->symbols[i + j] = (uint16_t)(1 + (((bits & 0xffff) * count) >> 16));
+    }
+    band->symbols_left = RAIN_SYMBOL_BATCH;
+}
+
+/* Bands draw symbols concurrently, so each has its own generator. */
+static inline uint16_t get_random_symbol(const Rain *rain, RainBand *band)
+{
+    if (band->symbols_left == 0)
+        refill_symbols(rain, band);
+    return band->symbols[--band->symbols_left];
+}
+
+/* On a tiled grid, put the tile holding row,col on its band's list the
+ * first time something is written to it.
+ */
+static inline void note_tile(Rain *rain, int row, int col)
+{
+    const size_t tile = grid_tile(&rain->grid, row, col);
+    if (rain->tile_live[tile])
+        return;
+    rain->tile_live[tile] = 1;
+    RainBand *band = &rain->bands[col / rain->band_cols];
+    band->tiles[band->tile_count++] = (uint32_t)tile;
+}
+
+static inline void clear_cell(Grid *grid, size_t cell)
+{
+    grid->glyph[cell] = GLYPH_EMPTY;
+    grid->color[cell] = 0;
+}
+
+/* Draw a symbol at row,col — width-aware and bounds-guarded.
+ * A wide glyph marks its right half with the same glyph and CELL_CONT. The
+ * grid never keeps half a wide glyph: overwriting either half of one clears
+ * the other, just as the terminal does. fade, and the speed bucket whose
+ * fade table it follows, go to the leading cell; every other cell the draw
+ * touches stops fading.
+ */
+ALWAYS_INLINE void draw_symbol(Rain *rain, RainBand *band, int row, int col, uint16_t glyph, ColorPair color_pair,
+                               uint8_t fade, uint8_t bucket, const bool wide)
+{
+    const int max_width = rain->width;
+    Grid *grid = &rain->grid;
+
+    if (row < 0 || row >= rain->height || col < 0 || col >= max_width)
+        return;
+
+    if (glyph == GLYPH_EMPTY)
+        return; // nothing to draw
+
+    const int w = wide ? palette_width(&rain->palette, glyph) : 1;
+    if (w == 2 && col == max_width - 1)
+    {
+        // Can't place wide char at last column
+        return;
+    }
+    if (grid->layout == GRID_TILED)
+    {
+        note_tile(rain, row, col);
+        note_tile(rain, row, col + w - 1);
+    }
+
+    const size_t cell = grid_index(grid, row, col);
+    int lo = col;
+    int hi = col + w;
+
+    if (wide)
+    {
+        if (grid->color[cell] & CELL_CONT)
+        {
+            clear_cell(grid, grid_index(grid, row, col - 1));
+            *fade_at(rain, row, col - 1) = 0;
+            lo = col - 1;
+        }
+        const size_t last = grid_index(grid, row, col + w - 1);
+        if ((grid->color[last] & CELL_WIDE) && hi < max_width)
+        {
+            clear_cell(grid, grid_index(grid, row, col + w));
+            hi++;
+        }
+    }
+
+    grid->glyph[cell] = glyph;
+    grid->color[cell] = color_pair | (w == 2 ? CELL_WIDE : 0);
+    *fade_at(rain, row, col) = fade;
+    *fade_bucket_at(rain, row, col) = bucket;
+    if (w == 2)
+    {
+        const size_t right = grid_index(grid, row, col + 1);
+        grid->glyph[right] = glyph; // mark trailing cell with same glyph (occupied)
+        grid->color[right] = color_pair | CELL_CONT;
+        *fade_at(rain, row, col + 1) = 0;
+    }
+
+    dirty_map_mark(&band->dirty, row, lo, hi);
+    band->cells_drawn += w;
+}
+
+/* Erase the glyph covering row,col; both halves if it is double-width. */
+ALWAYS_INLINE void erase_symbol(Rain *rain, RainBand *band, int row, int col, const bool wide)
+{
+    const int max_width = rain->width;
+    Grid *grid = &rain->grid;
+
+    if (row < 0 || col < 0 || col >= max_width)
+        return;
+    if (grid->layout == GRID_TILED)
+        note_tile(rain, row, col);
+
+    const size_t cell = grid_index(grid, row, col);
+    int lo = col;
+    int hi = col + 1;
+
+    if (wide && (grid->color[cell] & CELL_CONT))
+    {
+        // Right half of the neighbour's glyph; leave it if that is the message
+        if (is_revealed(rain, row, col - 1))
+            return;
+        clear_cell(grid, grid_index(grid, row, col - 1));
+        *fade_at(rain, row, col - 1) = 0;
+        lo = col - 1;
+    }
+    else if (wide && (grid->color[cell] & CELL_WIDE))
+    {
+        clear_cell(grid, grid_index(grid, row, col + 1));
+        hi = col + 2;
+    }
+
+    clear_cell(grid, cell);
+    *fade_at(rain, row, col) = 0;
+    dirty_map_mark(&band->dirty, row, lo, hi);
+    band->cells_erased += hi - lo;
+}
+
+/* Check if drawing a glyph at row,col would overwrite a revealed message character.
+ * With wide glyphs around that includes the half of a wide glyph the draw would clear.
+ */
+ALWAYS_INLINE int would_overwrite_revealed_message(const Rain *rain, int row, int col, uint16_t glyph, const bool wide)
+{
+    if (is_revealed(rain, row, col))
+        return 1;
+    if (!wide)
+        return 0;
+
+    const Grid *grid = &rain->grid;
+    const size_t cell = grid_index(grid, row, col);
+    const int last = col + palette_width(&rain->palette, glyph) - 1;
+
+    if (last >= rain->width)
+        return 0; // draw_symbol() will refuse it anyway
+    if (last > col && is_revealed(rain, row, last))
+        return 1;
+    if ((grid->color[cell] & CELL_CONT) && is_revealed(rain, row, col - 1))
+        return 1;
+    if ((grid->color[grid_index(grid, row, last)] & CELL_WIDE) && last + 1 < rain->width &&
+        is_revealed(rain, row, last + 1))
+        return 1;
+    return 0;
+}
+
+/* Out-of-line loops over the primitives, specialized on wide like the trail updates. */
+ALWAYS_INLINE size_t probe_draw(Rain *rain, const RainProbeCell *cells, size_t count, const bool wide)
+{
+    RainBand *band = &rain->bands[0];
+    const size_t before = band->cells_drawn;
+    for (size_t i = 0; i < count; i++)
+        draw_symbol(rain, band, cells[i].row, cells[i].col, cells[i].glyph, PAIR_BRIGHT_GREEN, 0, 0, wide);
+    return band->cells_drawn - before;
+}
+
+size_t rain_probe_draw(Rain *rain, const RainProbeCell *cells, size_t count)
+{
+    return rain->palette.all_narrow ? probe_draw(rain, cells, count, false) : probe_draw(rain, cells, count, true);
+}
+
+ALWAYS_INLINE size_t probe_erase(Rain *rain, const RainProbeCell *cells, size_t count, const bool wide)
+{
+    RainBand *band = &rain->bands[0];
+    const size_t before = band->cells_erased;
+    for (size_t i = 0; i < count; i++)
+        erase_symbol(rain, band, cells[i].row, cells[i].col, wide);
+    return band->cells_erased - before;
+}
+
+size_t rain_probe_erase(Rain *rain, const RainProbeCell *cells, size_t count)
+{
+    return rain->palette.all_narrow ? probe_erase(rain, cells, count, false) : probe_erase(rain, cells, count, true);
+}
+
+ALWAYS_INLINE size_t probe_would_overwrite(const Rain *rain, const RainProbeCell *cells, size_t count,
+                                           const bool wide)
+{
+    size_t hits = 0;
+    for (size_t i = 0; i < count; i++)
+        hits += would_overwrite_revealed_message(rain, cells[i].row, cells[i].col, cells[i].glyph, wide);
+    return hits;
+}
+
+size_t rain_probe_would_overwrite(const Rain *rain, const RainProbeCell *cells, size_t count)
+{
+    return rain->palette.all_narrow ? probe_would_overwrite(rain, cells, count, false)
+                                    : probe_would_overwrite(rain, cells, count, true);
+}
+
+size_t rain_probe_random_symbols(Rain *rain, size_t count)
+{
+    size_t sum = 0;
+    for (size_t i = 0; i < count; i++)
+        sum += get_random_symbol(rain, &rain->bands[0]);
+    return sum;
+}
@@ -0,0 +1,409 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "recording.h"
+#include "ansi.h"
+#include "scheduler.h"
+
+// Hidden cursor, black background, cleared: the state a recording starts from
+#define CAST_CLEAR_SEQUENCE "\x1b[?25l\x1b[0;40m\x1b[2J"
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+int recorder_open(Recorder *recorder, const char *path, int width, int height, int period_ms,
+                  const Palette *palette)
+{
+    *recorder = (Recorder){0};
+    recorder->file = fopen(path, "wb");
+    if (!recorder->file)
+        return -1;
+    setvbuf(recorder->file, NULL, _IOFBF, 1 << 16);
+
+    const RecordingHeader header = {
+        .magic = RECORDING_MAGIC,
+        .version = RECORDING_VERSION,
+        .byte_order = RECORDING_BYTE_ORDER,
+        .width = (uint32_t)width,
+        .height = (uint32_t)height,
+        .period_ms = (uint32_t)period_ms,
+        .symbol_count = (uint32_t)palette->count,
+        .rain_count = (uint32_t)palette->rain_count,
+        .color_mode = (uint32_t)palette->color_mode,
+    };
+    fwrite(&header, sizeof(header), 1, recorder->file);
+
+    for (size_t i = 0; i < palette->count; i++)
+    {
+        const uint32_t code_point = (uint32_t)palette->symbols[i];
+        fwrite(&code_point, sizeof(code_point), 1, recorder->file);
+    }
+    const uint64_t zero = 0;
+    fwrite(&zero, 1, align8(palette->count * 4) - palette->count * 4, recorder->file);
+
+    return ferror(recorder->file) ? -1 : 0;
+}
+
+int recorder_frame(Recorder *recorder, const DrawList *list)
+{
+    const RecordHeader record = {RECORD_FRAME, (uint32_t)list->count};
+    fwrite(&record, sizeof(record), 1, recorder->file);
+    fwrite(list->ops, sizeof(DrawOp), list->count, recorder->file);
+    recorder->frames++;
+    return ferror(recorder->file) ? -1 : 0;
+}
+
+int recorder_resize(Recorder *recorder, int width, int height)
+{
+    const RecordHeader record = {RECORD_RESIZE, 1};
+    const RecordingSize size = {(uint32_t)width, (uint32_t)height};
+    fwrite(&record, sizeof(record), 1, recorder->file);
+    fwrite(&size, sizeof(size), 1, recorder->file);
+    return ferror(recorder->file) ? -1 : 0;
+}
+
+int recorder_palette(Recorder *recorder, const Palette *palette, size_t first)
+{
+    const uint32_t count = (uint32_t)(palette->count - first);
+    const RecordHeader record = {RECORD_PALETTE, count};
+    fwrite(&record, sizeof(record), 1, recorder->file);
+    for (size_t i = first; i < palette->count; i++)
+    {
+        const uint32_t code_point = (uint32_t)palette->symbols[i];
+        fwrite(&code_point, sizeof(code_point), 1, recorder->file);
+    }
+    const uint64_t zero = 0;
+    fwrite(&zero, 1, align8(count * 4) - count * 4, recorder->file);
+    return ferror(recorder->file) ? -1 : 0;
+}
+
+int recorder_close(Recorder *recorder)
+{
+    const int status = fclose(recorder->file) == 0 ? 0 : -1;
+    *recorder = (Recorder){0};
+    return status;
+}
+
+/* A recording mapped read-only. The whole file is checked once when it is
+ * opened, so playing it back trusts every record.
+ */
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    RecordingHeader header;
+    Palette palette;
+} Playback;
+
+static int check_records(const Playback *playback, size_t pos)
+{
+    uint32_t width = playback->header.width;
+    uint32_t height = playback->header.height;
+    size_t symbols = playback->palette.count;
+
+    while (pos < playback->size)
+    {
+        if (playback->size - pos < sizeof(RecordHeader))
+            return -1;
+        const RecordHeader *record = (const RecordHeader *)(playback->data + pos);
+        pos += sizeof(RecordHeader);
+
+        if (record->kind == RECORD_RESIZE)
+        {
+            if (playback->size - pos < sizeof(RecordingSize))
+                return -1;
+            const RecordingSize *size = (const RecordingSize *)(playback->data + pos);
+            if (size->width == 0 || size->height == 0 || size->width > UINT16_MAX || size->height > UINT16_MAX)
+                return -1;
+            width = size->width;
+            height = size->height;
+            pos += sizeof(RecordingSize);
+            continue;
+        }
+
+        if (record->kind == RECORD_PALETTE)
+        {
+            const size_t bytes = align8((size_t)record->count * 4);
+            if (playback->size - pos < bytes || symbols + record->count > UINT16_MAX)
+                return -1;
+            symbols += record->count;
+            pos += bytes;
+            continue;
+        }
+
+        if (record->kind != RECORD_FRAME || (playback->size - pos) / sizeof(DrawOp) < record->count)
+            return -1;
+        const DrawOp *ops = (const DrawOp *)(playback->data + pos);
+        for (uint32_t i = 0; i < record->count; i++)
+        {
+            const DrawOp *op = &ops[i];
+            if (op->row >= height || op->col + op->cells > width || op->cells == 0 || op->cells > 2 ||
+                op->glyph >= symbols || op->color_pair > playback->palette.shade_count)
+                return -1;
+        }
+        pos += record->count * sizeof(DrawOp);
+    }
+    return 0;
+}
+
+static void playback_close(Playback *playback)
+{
+    palette_free(&playback->palette);
+    if (playback->data)
+        munmap((void *)playback->data, playback->size);
+    *playback = (Playback){0};
+}
+
+static int playback_open(Playback *playback, const char *path)
+{
+    *playback = (Playback){0};
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RecordingHeader))
+    {
+        fprintf(stderr, "Error: '%s' is not a recording\n", path);
+        close(fd);
+        return -1;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror(path);
+        return -1;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    playback->data = data;
+    playback->size = st.st_size;
+
+    const RecordingHeader *header = data;
+    playback->header = *header;
+    const size_t symbols_end = sizeof(RecordingHeader) + align8((size_t)header->symbol_count * 4);
+    if (header->magic != RECORDING_MAGIC || header->version != RECORDING_VERSION ||
+        header->byte_order != RECORDING_BYTE_ORDER || header->width == 0 || header->height == 0 ||
+        header->width > UINT16_MAX || header->height > UINT16_MAX || header->rain_count == 0 ||
+        header->rain_count >= header->symbol_count || header->symbol_count > UINT16_MAX ||
+        header->color_mode > COLORS_TRUECOLOR || symbols_end > playback->size)
+    {
+        fprintf(stderr, "Error: '%s' is not a recording this build can play\n", path);
+        playback_close(playback);
+        return -1;
+    }
+
+    // Rebuild the palette from its code points; entry 0 is always the blank
+    const uint32_t *code_points = (const uint32_t *)(playback->data + sizeof(RecordingHeader));
+    const size_t rain_count = header->rain_count;
+    const size_t message_count = header->symbol_count - 1 - rain_count;
+    wchar_t *rain_symbols = malloc((rain_count + 1) * sizeof(wchar_t));
+    wchar_t *message_symbols = malloc((message_count + 1) * sizeof(wchar_t));
+    int status = -1;
+    if (rain_symbols && message_symbols)
+    {
+        for (size_t i = 0; i < rain_count; i++)
+            rain_symbols[i] = (wchar_t)code_points[1 + i];
+        rain_symbols[rain_count] = L'\0';
+        for (size_t i = 0; i < message_count; i++)
+            message_symbols[i] = (wchar_t)code_points[1 + rain_count + i];
+        message_symbols[message_count] = L'\0';
+
+        // Entries the palette would merge mean the indices no longer match the file
+        status = palette_init(&playback->palette, rain_symbols, message_symbols);
+        if (status == 0 && playback->palette.count != header->symbol_count)
+            status = -1;
+        if (status == 0)
+            palette_set_colors(&playback->palette, (ColorMode)header->color_mode);
+    }
+    free(rain_symbols);
+    free(message_symbols);
+
+    if (status != 0 || check_records(playback, symbols_end) != 0)
+    {
+        fprintf(stderr, "Error: '%s' is damaged\n", path);
+        playback_close(playback);
+        return -1;
+    }
+
+    playback->pos = symbols_end;
+    return 0;
+}
+
+/* Append count code points to the palette. */
+static int extend_palette(Playback *playback, const uint32_t *code_points, uint32_t count)
+{
+    wchar_t *symbols = malloc((count + 1) * sizeof(wchar_t));
+    if (!symbols)
+        return -1;
+    for (uint32_t i = 0; i < count; i++)
+        symbols[i] = (wchar_t)code_points[i];
+    symbols[count] = L'\0';
+
+    const size_t expected = playback->palette.count + count;
+    const int status = palette_extend(&playback->palette, symbols);
+    free(symbols);
+    return status == 0 && playback->palette.count == expected ? 0 : -1;
+}
+
+/* The next record: RECORD_FRAME with list pointing into the mapping,
+ * RECORD_RESIZE with size filled in, or 0 at the end or on failure. Palette
+ * records are applied on the way.
+ */
+static int playback_next(Playback *playback, DrawList *list, RecordingSize *size)
+{
+    if (playback->pos >= playback->size)
+        return 0;
+
+    const RecordHeader *record = (const RecordHeader *)(playback->data + playback->pos);
+    playback->pos += sizeof(RecordHeader);
+
+    if (record->kind == RECORD_PALETTE)
+    {
+        const uint32_t *code_points = (const uint32_t *)(playback->data + playback->pos);
+        playback->pos += align8((size_t)record->count * 4);
+        if (extend_palette(playback, code_points, record->count) != 0)
+            return 0;
+        return playback_next(playback, list, size);
+    }
+
+    if (record->kind == RECORD_RESIZE)
+    {
+        *size = *(const RecordingSize *)(playback->data + playback->pos);
+        playback->pos += sizeof(RecordingSize);
+        return RECORD_RESIZE;
+    }
+
+    // Renderers only read the list, so it can point into the read-only mapping
+    list->ops = (DrawOp *)(playback->data + playback->pos);
+    list->count = record->count;
+    list->capacity = record->count;
+    playback->pos += record->count * sizeof(DrawOp);
+    return RECORD_FRAME;
+}
+
+int playback_run(const char *path, const Renderer *renderer, int period_ms, const volatile sig_atomic_t *stop)
+{
+    Playback playback;
+    if (playback_open(&playback, path) != 0)
+        return 1;
+
+    int width = (int)playback.header.width;
+    int height = (int)playback.header.height;
+    if (renderer->init(STDOUT_FILENO, &width, &height) != 0)
+    {
+        playback_close(&playback);
+        return 1;
+    }
+
+    FrameScheduler scheduler;
+    scheduler_init(&scheduler, period_ms > 0 ? period_ms : (int)playback.header.period_ms, FRAME_SKIP);
+
+    DrawList list;
+    RecordingSize size;
+    int kind;
+    while (!*stop && (kind = playback_next(&playback, &list, &size)) != 0)
+    {
+        if (kind == RECORD_RESIZE)
+        {
+            // Only the clear matters; the frame after it redraws everything
+            renderer->resize(&width, &height);
+            continue;
+        }
+
+        renderer->present(&list, &playback.palette);
+        while (scheduler_wait(&scheduler) == 0 && !*stop)
+            ;
+    }
+
+    renderer->shutdown();
+    playback_close(&playback);
+    return 0;
+}
+
+/* Write bytes as the body of a JSON string. */
+static void write_json_string(FILE *out, const char *bytes, size_t len)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < len; i++)
+    {
+        const unsigned char c = (unsigned char)bytes[i];
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20 || c == 0x7f)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+int playback_export_cast(const char *path, const char *cast_path, int period_ms)
+{
+    Playback playback;
+    if (playback_open(&playback, path) != 0)
+        return 1;
+
+    FILE *out = fopen(cast_path, "w");
+    AnsiBuffer buf;
+    if (!out || ansi_buffer_init(&buf, (int)playback.header.width) != 0)
+    {
+        perror(cast_path);
+        if (out)
+            fclose(out);
+        playback_close(&playback);
+        return 1;
+    }
+
+    const double period = (period_ms > 0 ? period_ms : (int)playback.header.period_ms) / 1000.0;
+    double t = 0;
+
+    fprintf(out, "{\"version\": 2, \"width\": %u, \"height\": %u, \"env\": {\"TERM\": \"xterm-256color\"}}\n",
+            playback.header.width, playback.header.height);
+    fprintf(out, "[%.6f, \"o\", ", t);
+    write_json_string(out, CAST_CLEAR_SEQUENCE, strlen(CAST_CLEAR_SEQUENCE));
+    fputs("]\n", out);
+
+    DrawList list;
+    RecordingSize size;
+    int kind;
+    while ((kind = playback_next(&playback, &list, &size)) != 0)
+    {
+        if (kind == RECORD_RESIZE)
+        {
+            fprintf(out, "[%.6f, \"r\", \"%ux%u\"]\n", t, size.width, size.height);
+            fprintf(out, "[%.6f, \"o\", ", t);
+            write_json_string(out, CAST_CLEAR_SEQUENCE, strlen(CAST_CLEAR_SEQUENCE));
+            fputs("]\n", out);
+            buf.width = (int)size.width;
+            ansi_invalidate(&buf);
+            continue;
+        }
+
+        ansi_begin_frame(&buf);
+        if (ansi_encode(&buf, &list, &playback.palette) == 0 && buf.len > 0)
+        {
+            fprintf(out, "[%.6f, \"o\", ", t);
+            write_json_string(out, buf.data, buf.len);
+            fputs("]\n", out);
+        }
+        t += period;
+    }
+
+    const int status = ferror(out) ? 1 : 0;
+    fclose(out);
+    ansi_buffer_free(&buf);
+    playback_close(&playback);
+    return status;
+}
@@ -0,0 +1,58 @@
+#include <string.h>
+
+#include "render.h"
+
+static const Renderer *const renderers[] = {
+    &ncurses_renderer,
+    &ansi_renderer,
+    &null_renderer,
+    &ppm_renderer,
+    &y4m_renderer,
+};
+
+const Renderer *renderer_find(const char *name)
+{
+    for (size_t i = 0; i < sizeof(renderers) / sizeof(renderers[0]); i++)
+    {
+        if (strcmp(renderers[i]->name, name) == 0)
+            return renderers[i];
+    }
+    return NULL;
+}
+
+/* Discards everything; measures the simulation alone. */
+static int null_init(int fd, int *width, int *height)
+{
+    if (*width <= 0)
+        *width = 80;
+    if (*height <= 0)
+        *height = 24;
+    return 0;
+}
+
+static void null_present(const DrawList *list, const Palette *palette)
+{
+}
+
+static int null_resize(int *width, int *height)
+{
+    return 0;
+}
+
+static void null_shutdown(void)
+{
+}
+
+static size_t null_bytes_written(void)
+{
+    return 0;
+}
+
+const Renderer null_renderer = {
+    .name = "null",
+    .init = null_init,
+    .present = null_present,
+    .resize = null_resize,
+    .shutdown = null_shutdown,
+    .bytes_written = null_bytes_written,
+};
@@ -0,0 +1,136 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "ansi.h"
+#include "render.h"
+
+// Alternate screen, hidden cursor, black background, cleared
+#define ENTER_SEQUENCE "\x1b[?1049h\x1b[?25l\x1b[0;40m\x1b[2J"
+#define CLEAR_SEQUENCE "\x1b[0;40m\x1b[2J"
+#define LEAVE_SEQUENCE "\x1b[0m\x1b[?25h\x1b[?1049l"
+
+static int out_fd = -1;
+static AnsiBuffer frame;
+static struct termios saved_termios;
+static int termios_saved = 0;
+static atomic_size_t bytes_out; // Read by bytes_written() from the main thread
+static atomic_bool lost; // A frame could not be encoded; taken by frame_lost()
+
+/* Write all of len, retrying on short writes and signals. */
+static int write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+        atomic_fetch_add_explicit(&bytes_out, n, memory_order_relaxed);
+    }
+    return 0;
+}
+
+static int ansi_init(int fd, int *width, int *height)
+{
+    out_fd = fd;
+    atomic_store_explicit(&bytes_out, 0, memory_order_relaxed);
+    atomic_store_explicit(&lost, false, memory_order_relaxed);
+
+    struct winsize ws;
+    if (ioctl(fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0)
+    {
+        if (*width <= 0)
+            *width = ws.ws_col;
+        if (*height <= 0)
+            *height = ws.ws_row;
+    }
+    if (*width <= 0)
+        *width = 80;
+    if (*height <= 0)
+        *height = 24;
+
+    // Same input mode as the ncurses output: no line buffering, no echo
+    if (isatty(fd) && tcgetattr(fd, &saved_termios) == 0)
+    {
+        struct termios raw = saved_termios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(fd, TCSANOW, &raw);
+        termios_saved = 1;
+    }
+
+    if (ansi_buffer_init(&frame, *width) != 0)
+        return 1;
+
+    return write_all(out_fd, ENTER_SEQUENCE, strlen(ENTER_SEQUENCE)) == 0 ? 0 : 1;
+}
+
+static void ansi_present(const DrawList *list, const Palette *palette)
+{
+    ansi_begin_frame(&frame);
+    if (ansi_encode(&frame, list, palette) != 0)
+    {
+        // Out of memory: nothing was sent, but the front copy already holds these cells
+        ansi_invalidate(&frame);
+        atomic_store_explicit(&lost, true, memory_order_relaxed);
+        return;
+    }
+
+    // The whole frame leaves in one write()
+    write_all(out_fd, frame.data, frame.len);
+}
+
+static int ansi_resize(int *width, int *height)
+{
+    struct winsize ws;
+    if (ioctl(out_fd, TIOCGWINSZ, &ws) != 0 || ws.ws_col == 0 || ws.ws_row == 0)
+        return 1;
+
+    *width = ws.ws_col;
+    *height = ws.ws_row;
+    frame.width = ws.ws_col;
+
+    // Whatever the terminal did to the old contents, start from a blank screen
+    ansi_invalidate(&frame);
+    return write_all(out_fd, CLEAR_SEQUENCE, strlen(CLEAR_SEQUENCE)) == 0 ? 0 : 1;
+}
+
+static void ansi_shutdown(void)
+{
+    write_all(out_fd, LEAVE_SEQUENCE, strlen(LEAVE_SEQUENCE));
+    if (termios_saved)
+    {
+        tcsetattr(out_fd, TCSANOW, &saved_termios);
+        termios_saved = 0;
+    }
+    ansi_buffer_free(&frame);
+    out_fd = -1;
+}
+
+static size_t ansi_bytes_written(void)
+{
+    return atomic_load_explicit(&bytes_out, memory_order_relaxed);
+}
+
+static bool ansi_frame_lost(void)
+{
+    return atomic_exchange_explicit(&lost, false, memory_order_relaxed);
+}
+
+const Renderer ansi_renderer = {
+    .name = "ansi",
+    .init = ansi_init,
+    .present = ansi_present,
+    .resize = ansi_resize,
+    .shutdown = ansi_shutdown,
+    .bytes_written = ansi_bytes_written,
+    .frame_lost = ansi_frame_lost,
+};
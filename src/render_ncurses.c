@@ -0,0 +1,280 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <ncursesw/ncurses.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "render.h"
+
+// Shade n gets color slot COLOR_FIRST_SHADE + n - 1; the first 8 slots are reserved by ncurses
+#define COLOR_FIRST_SHADE 8
+
+static int init_colors();
+static void ncurses_shutdown(void);
+static void init_shades(const Palette *palette);
+
+static SCREEN *screen;
+static FILE *out;
+static int shades_mode = -1; // ColorMode the color pairs are set up for, -1 before the first frame
+
+/* ncurses writes its buffer straight to the descriptor of the FILE it is
+ * given, so to count what it sends it is given the write end of a pipe,
+ * which a thread copies to the terminal. Terminal modes and size are then
+ * handled here, on the terminal itself, as ncurses can't reach it.
+ */
+static int tty_fd = -1;
+static int relay_fd = -1; // Read end of the pipe
+static pthread_t relay_thread;
+static bool relaying;
+static struct termios saved_termios;
+static bool termios_saved;
+static atomic_size_t bytes_out; // Read by bytes_written() from the main thread
+static atomic_bool tty_failed;  // A write to the terminal failed; frames are no longer drawn
+
+static void *relay_output(void *arg)
+{
+    char buf[16384];
+    ssize_t n;
+    while ((n = read(relay_fd, buf, sizeof(buf))) != 0)
+    {
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        // Once the terminal is gone the pipe is still drained, so ncurses never blocks on a full one
+        for (ssize_t done = 0; done < n && !atomic_load_explicit(&tty_failed, memory_order_relaxed);)
+        {
+            const ssize_t written = write(tty_fd, buf + done, n - done);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+            {
+                atomic_store_explicit(&tty_failed, true, memory_order_relaxed);
+                break;
+            }
+            done += written;
+            atomic_fetch_add_explicit(&bytes_out, written, memory_order_relaxed);
+        }
+    }
+    return NULL;
+}
+
+/* Start the pipe and its relay to fd; out becomes the pipe's write end. */
+static int start_relay(int fd)
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+        return -1;
+#ifdef F_SETPIPE_SZ
+    // Keep the pipe's own buffer small, so a slow terminal still blocks refresh() as it did
+    fcntl(fds[1], F_SETPIPE_SZ, 4096);
+#endif
+    tty_fd = dup(fd);
+    relay_fd = fds[0];
+    out = fdopen(fds[1], "w");
+    if (tty_fd < 0 || !out)
+    {
+        if (!out)
+            close(fds[1]);
+        return -1;
+    }
+
+    atomic_store_explicit(&bytes_out, 0, memory_order_relaxed);
+    atomic_store_explicit(&tty_failed, false, memory_order_relaxed);
+    if (pthread_create(&relay_thread, NULL, relay_output, NULL) != 0)
+        return -1;
+    relaying = true;
+    return 0;
+}
+
+static void stop_relay(void)
+{
+    if (out)
+        fclose(out); // The relay reads to the end of what is left and stops
+    if (relaying)
+        pthread_join(relay_thread, NULL);
+    if (termios_saved)
+    {
+        // After the relay, so the terminal has everything endwin() sent first
+        tcsetattr(tty_fd, TCSANOW, &saved_termios);
+        termios_saved = false;
+    }
+    if (relay_fd >= 0)
+        close(relay_fd);
+    if (tty_fd >= 0)
+        close(tty_fd);
+    out = NULL;
+    relaying = false;
+    relay_fd = tty_fd = -1;
+}
+
+static int ncurses_init(int fd, int *width, int *height)
+{
+    // Without a usable TERM (e.g. headless bench runs) assume a common color terminal
+    const char *term = getenv("TERM");
+    if (!term || !*term || strcmp(term, "dumb") == 0)
+        term = "xterm-256color";
+
+    if (start_relay(fd) != 0)
+    {
+        stop_relay();
+        return 1;
+    }
+
+    screen = newterm(term, out, stdin);
+    if (!screen)
+    {
+        stop_relay();
+        printf("Can't initialize terminal '%s'\n", term);
+        return 1;
+    }
+    set_term(screen);
+
+    // What cbreak() and noecho() would do, had ncurses the terminal
+    if (isatty(tty_fd) && tcgetattr(tty_fd, &saved_termios) == 0)
+    {
+        struct termios raw = saved_termios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(tty_fd, TCSANOW, &raw);
+        termios_saved = true;
+    }
+
+    struct winsize ws;
+    if (ioctl(tty_fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0)
+    {
+        if (*width <= 0)
+            *width = ws.ws_col;
+        if (*height <= 0)
+            *height = ws.ws_row;
+    }
+    if (*width > 0 && *height > 0)
+        resizeterm(*height, *width);
+
+    curs_set(0);
+    getmaxyx(stdscr, *height, *width);
+    keypad(stdscr, TRUE);
+
+    if (init_colors() != 0)
+    {
+        ncurses_shutdown();
+        return 1;
+    }
+    return 0;
+}
+
+static void ncurses_present(const DrawList *list, const Palette *palette)
+{
+    // As with the ansi renderer, frames the terminal can't take are dropped
+    if (atomic_load_explicit(&tty_failed, memory_order_relaxed))
+        return;
+    if ((int)palette->color_mode != shades_mode)
+        init_shades(palette);
+
+    for (size_t i = 0; i < list->count; i++)
+    {
+        const DrawOp *op = &list->ops[i];
+
+        if (op->color_pair == 0)
+        {
+            mvaddwstr(op->row, op->col, op->cells == 2 ? L"  " : L" ");
+            continue;
+        }
+
+        attron(COLOR_PAIR(op->color_pair));
+
+        wchar_t buf[2] = {palette_symbol(palette, op->glyph), L'\0'};
+        mvaddwstr(op->row, op->col, buf);
+    }
+
+    refresh();
+}
+
+static int ncurses_resize(int *width, int *height)
+{
+    struct winsize ws;
+    if (ioctl(tty_fd, TIOCGWINSZ, &ws) != 0 || ws.ws_col == 0 || ws.ws_row == 0)
+        return 1;
+
+    resizeterm(ws.ws_row, ws.ws_col);
+    clear();
+    refresh();
+    getmaxyx(stdscr, *height, *width);
+    return 0;
+}
+
+static void ncurses_shutdown(void)
+{
+    endwin();
+    delscreen(screen);
+    stop_relay();
+    screen = NULL;
+    shades_mode = -1;
+}
+
+static size_t ncurses_bytes_written(void)
+{
+    return atomic_load_explicit(&bytes_out, memory_order_relaxed);
+}
+
+const Renderer ncurses_renderer = {
+    .name = "ncurses",
+    .init = ncurses_init,
+    .present = ncurses_present,
+    .resize = ncurses_resize,
+    .shutdown = ncurses_shutdown,
+    .bytes_written = ncurses_bytes_written,
+};
+
+static int init_colors()
+{
+    if (has_colors() == FALSE)
+    {
+        endwin();
+        printf("Your terminal does not support color\n");
+        return 1;
+    }
+
+    if (can_change_color() == FALSE)
+    {
+        endwin();
+        printf("Your terminal does not support changing color\n");
+        return 1;
+    }
+
+    start_color();
+    init_color(COLOR_BLACK, 0, 0, 0);
+
+    return 0;
+}
+
+/* One color pair per palette shade, the pair number being the shade. The
+ * 256-color ramp uses the terminal's own colors where it has them; anything
+ * else is defined with init_color().
+ */
+static void init_shades(const Palette *palette)
+{
+    const bool indexed = palette->color_mode == COLORS_256 && COLORS >= 256;
+
+    for (int shade = 1; shade <= palette->shade_count; shade++)
+    {
+        if (indexed)
+        {
+            init_pair(shade, palette->shade_xterm[shade], COLOR_BLACK);
+            continue;
+        }
+
+        const uint8_t *rgb = palette->shade_rgb[shade];
+        const short color = COLOR_FIRST_SHADE + shade - 1;
+        init_color(color, rgb[0] * 1000 / 255, rgb[1] * 1000 / 255, rgb[2] * 1000 / 255);
+        init_pair(shade, color, COLOR_BLACK);
+    }
+    shades_mode = palette->color_mode;
+}
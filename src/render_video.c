@@ -0,0 +1,363 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "font.h"
+#include "render.h"
+
+// Pixels per terminal cell; the default grid then makes 1920x1080 frames
+#define CELL_WIDTH 12
+#define CELL_HEIGHT 20
+#define DEFAULT_COLUMNS 160
+#define DEFAULT_ROWS 54
+
+// Font pixels become FONT_SCALE x FONT_SCALE blocks, centered in the cell
+#define FONT_SCALE 2
+
+// Coverage of the pixels around a stroke: a faint glow that blends into the black
+#define GLOW_ALPHA 72
+
+// Atlas entries are two cells wide, so double-width glyphs fit
+#define ATLAS_WIDTH (2 * CELL_WIDTH)
+#define ATLAS_SIZE (ATLAS_WIDTH * CELL_HEIGHT)
+#define CHROMA_ATLAS_SIZE (ATLAS_SIZE / 4)
+
+typedef enum
+{
+    VIDEO_PPM,
+    VIDEO_Y4M
+} VideoFormat;
+
+/* Rasterizes draw ops into a frame held in the output format itself, so a
+ * present only blits the changed cells and writes the frame out. Glyphs come
+ * from an atlas of coverage masks built from the built-in font; a pixel's
+ * value for each shade and coverage is looked up, never computed per frame.
+ */
+static struct
+{
+    VideoFormat format;
+    int fd;
+    int period_ms;
+    int columns;
+    int rows;
+    int width;  // Pixels
+    int height;
+
+    uint8_t *frame; // The frame with its per-frame header in front, written out whole
+    size_t frame_len;
+    uint8_t *pixels; // PPM: RGB triples; Y4M: the Y plane, then U and V at half resolution
+
+    uint8_t *atlas;        // ATLAS_SIZE coverage bytes per palette glyph
+    uint8_t *chroma_atlas; // The same averaged over 2x2 blocks, for the Y4M chroma planes
+    size_t atlas_count;
+
+    int shades_mode; // ColorMode the lookup table is built for, -1 for none
+    uint8_t lut[PALETTE_MAX_SHADES + 1][256][3]; // Shade 0 is black at any coverage
+
+    atomic_size_t bytes_out;
+} video = {.shades_mode = -1, .period_ms = 50};
+
+void video_set_frame_period(int period_ms)
+{
+    video.period_ms = period_ms > 0 ? period_ms : 1;
+}
+
+/* Write all of len, retrying on short writes and signals. */
+static int write_all(int fd, const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+        atomic_fetch_add_explicit(&video.bytes_out, n, memory_order_relaxed);
+    }
+    return 0;
+}
+
+/* RGB scaled by coverage over black, in the frame's own encoding. */
+static void build_luts(const Palette *palette)
+{
+    for (int shade = 0; shade <= PALETTE_MAX_SHADES; shade++)
+    {
+        const uint8_t *rgb = shade >= 1 && shade <= palette->shade_count ? palette->shade_rgb[shade] : NULL;
+        for (int alpha = 0; alpha < 256; alpha++)
+        {
+            const double r = rgb ? rgb[0] * alpha / 255.0 : 0;
+            const double g = rgb ? rgb[1] * alpha / 255.0 : 0;
+            const double b = rgb ? rgb[2] * alpha / 255.0 : 0;
+            uint8_t *out = video.lut[shade][alpha];
+            if (video.format == VIDEO_PPM)
+            {
+                out[0] = (uint8_t)(r + 0.5);
+                out[1] = (uint8_t)(g + 0.5);
+                out[2] = (uint8_t)(b + 0.5);
+            }
+            else
+            {
+                // BT.601, limited range
+                out[0] = (uint8_t)(16.5 + (65.481 * r + 128.553 * g + 24.966 * b) / 255);
+                out[1] = (uint8_t)(128.5 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255);
+                out[2] = (uint8_t)(128.5 + (112.0 * r - 93.786 * g - 18.214 * b) / 255);
+            }
+        }
+    }
+    video.shades_mode = palette->color_mode;
+}
+
+/* Coverage mask of one glyph: the font bitmap scaled up and centered in
+ * its one or two cells, with a glow around the strokes. Characters the
+ * font lacks are drawn as an empty box.
+ */
+static void rasterize_glyph(const Palette *palette, uint16_t glyph, uint8_t *mask, uint8_t *chroma)
+{
+    static const uint8_t missing[FONT_HEIGHT] = {0x1f, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1f};
+
+    memset(mask, 0, ATLAS_SIZE);
+    if (glyph != GLYPH_EMPTY)
+    {
+        const uint8_t *rows = font_glyph(palette_symbol(palette, glyph));
+        if (!rows)
+            rows = missing;
+
+        const int span = palette_width(palette, glyph) * CELL_WIDTH;
+        const int x0 = (span - FONT_WIDTH * FONT_SCALE) / 2;
+        const int y0 = (CELL_HEIGHT - FONT_HEIGHT * FONT_SCALE) / 2;
+
+        for (int fy = 0; fy < FONT_HEIGHT; fy++)
+        {
+            for (int fx = 0; fx < FONT_WIDTH; fx++)
+            {
+                if (!(rows[fy] & (1 << (FONT_WIDTH - 1 - fx))))
+                    continue;
+                const int px = x0 + fx * FONT_SCALE;
+                const int py = y0 + fy * FONT_SCALE;
+
+                // The glow first, so the stroke itself overwrites it
+                for (int y = py - 1; y <= py + FONT_SCALE; y++)
+                {
+                    for (int x = px - 1; x <= px + FONT_SCALE; x++)
+                    {
+                        if (x >= 0 && x < span && y >= 0 && y < CELL_HEIGHT && mask[y * ATLAS_WIDTH + x] < GLOW_ALPHA)
+                            mask[y * ATLAS_WIDTH + x] = GLOW_ALPHA;
+                    }
+                }
+                for (int y = py; y < py + FONT_SCALE; y++)
+                    memset(mask + y * ATLAS_WIDTH + px, 255, FONT_SCALE);
+            }
+        }
+    }
+
+    for (int y = 0; y < CELL_HEIGHT / 2; y++)
+    {
+        for (int x = 0; x < ATLAS_WIDTH / 2; x++)
+        {
+            const uint8_t *p = mask + 2 * y * ATLAS_WIDTH + 2 * x;
+            chroma[y * (ATLAS_WIDTH / 2) + x] = (uint8_t)((p[0] + p[1] + p[ATLAS_WIDTH] + p[ATLAS_WIDTH + 1] + 2) / 4);
+        }
+    }
+}
+
+/* Masks for glyphs the palette gained since the last frame. */
+static int extend_atlas(const Palette *palette)
+{
+    uint8_t *atlas = realloc(video.atlas, palette->count * ATLAS_SIZE);
+    if (!atlas)
+        return -1;
+    video.atlas = atlas;
+    uint8_t *chroma = realloc(video.chroma_atlas, palette->count * CHROMA_ATLAS_SIZE);
+    if (!chroma)
+        return -1;
+    video.chroma_atlas = chroma;
+
+    for (size_t glyph = video.atlas_count; glyph < palette->count; glyph++)
+        rasterize_glyph(palette, (uint16_t)glyph, atlas + glyph * ATLAS_SIZE, chroma + glyph * CHROMA_ATLAS_SIZE);
+    video.atlas_count = palette->count;
+    return 0;
+}
+
+/* Draw one op's cells: every pixel is a table lookup of the glyph's coverage. */
+static void blit(const DrawOp *op)
+{
+    const int x0 = op->col * CELL_WIDTH;
+    const int y0 = op->row * CELL_HEIGHT;
+    int span = op->cells * CELL_WIDTH;
+    if (x0 + span > video.width)
+        span = video.width - x0;
+
+    const uint8_t (*lut)[3] = video.lut[op->glyph == GLYPH_EMPTY ? 0 : op->color_pair];
+    const uint8_t *mask = video.atlas + (size_t)op->glyph * ATLAS_SIZE;
+
+    if (video.format == VIDEO_PPM)
+    {
+        for (int y = 0; y < CELL_HEIGHT; y++)
+        {
+            uint8_t *out = video.pixels + ((size_t)(y0 + y) * video.width + x0) * 3;
+            const uint8_t *coverage = mask + y * ATLAS_WIDTH;
+            for (int x = 0; x < span; x++, out += 3)
+            {
+                const uint8_t *rgb = lut[coverage[x]];
+                out[0] = rgb[0];
+                out[1] = rgb[1];
+                out[2] = rgb[2];
+            }
+        }
+        return;
+    }
+
+    for (int y = 0; y < CELL_HEIGHT; y++)
+    {
+        uint8_t *luma = video.pixels + (size_t)(y0 + y) * video.width + x0;
+        const uint8_t *coverage = mask + y * ATLAS_WIDTH;
+        for (int x = 0; x < span; x++)
+            luma[x] = lut[coverage[x]][0];
+    }
+
+    // Cells are an even number of pixels on each side, so they cover whole chroma samples
+    const int chroma_width = video.width / 2;
+    const size_t plane = (size_t)chroma_width * (video.height / 2);
+    const uint8_t *chroma_mask = video.chroma_atlas + (size_t)op->glyph * CHROMA_ATLAS_SIZE;
+    uint8_t *u = video.pixels + (size_t)video.width * video.height;
+    uint8_t *v = u + plane;
+    for (int y = 0; y < CELL_HEIGHT / 2; y++)
+    {
+        const size_t at = (size_t)(y0 / 2 + y) * chroma_width + x0 / 2;
+        const uint8_t *coverage = chroma_mask + y * (ATLAS_WIDTH / 2);
+        for (int x = 0; x < span / 2; x++)
+        {
+            u[at + x] = lut[coverage[x]][1];
+            v[at + x] = lut[coverage[x]][2];
+        }
+    }
+}
+
+/* Paint the whole frame black. */
+static void clear_frame(void)
+{
+    const size_t pixels = (size_t)video.width * video.height;
+    if (video.format == VIDEO_PPM)
+    {
+        memset(video.pixels, 0, pixels * 3);
+        return;
+    }
+    memset(video.pixels, 16, pixels);              // Y
+    memset(video.pixels + pixels, 128, pixels / 2); // U and V
+}
+
+static int video_init(VideoFormat format, int fd, int *width, int *height)
+{
+    video.format = format;
+    video.fd = fd;
+    video.columns = *width > 0 ? *width : DEFAULT_COLUMNS;
+    video.rows = *height > 0 ? *height : DEFAULT_ROWS;
+    video.width = video.columns * CELL_WIDTH;
+    video.height = video.rows * CELL_HEIGHT;
+    video.shades_mode = -1;
+    video.atlas_count = 0;
+    atomic_store_explicit(&video.bytes_out, 0, memory_order_relaxed);
+
+    char header[64];
+    int header_len;
+    size_t pixel_bytes;
+    if (format == VIDEO_PPM)
+    {
+        // Every frame is a complete image, e.g. for ffmpeg -f image2pipe
+        header_len = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", video.width, video.height);
+        pixel_bytes = (size_t)video.width * video.height * 3;
+    }
+    else
+    {
+        char stream[96];
+        const int len = snprintf(stream, sizeof(stream), "YUV4MPEG2 W%d H%d F1000:%d Ip A1:1 C420jpeg\n",
+                                 video.width, video.height, video.period_ms);
+        if (write_all(fd, (const uint8_t *)stream, len) != 0)
+            return 1;
+        header_len = snprintf(header, sizeof(header), "FRAME\n");
+        pixel_bytes = (size_t)video.width * video.height * 3 / 2;
+    }
+
+    video.frame_len = header_len + pixel_bytes;
+    video.frame = malloc(video.frame_len);
+    if (!video.frame)
+        return 1;
+    memcpy(video.frame, header, header_len);
+    video.pixels = video.frame + header_len;
+    clear_frame();
+
+    *width = video.columns;
+    *height = video.rows;
+    return 0;
+}
+
+static int ppm_init(int fd, int *width, int *height)
+{
+    return video_init(VIDEO_PPM, fd, width, height);
+}
+
+static int y4m_init(int fd, int *width, int *height)
+{
+    return video_init(VIDEO_Y4M, fd, width, height);
+}
+
+static void video_present(const DrawList *list, const Palette *palette)
+{
+    if ((int)palette->color_mode != video.shades_mode)
+        build_luts(palette);
+    if (palette->count > video.atlas_count && extend_atlas(palette) != 0)
+        return;
+
+    for (size_t i = 0; i < list->count; i++)
+        blit(&list->ops[i]);
+
+    // A video needs every frame, changed or not
+    write_all(video.fd, video.frame, video.frame_len);
+}
+
+static int video_resize(int *width, int *height)
+{
+    return 1; // Frames keep the size the stream started with
+}
+
+static void video_shutdown(void)
+{
+    free(video.frame);
+    free(video.atlas);
+    free(video.chroma_atlas);
+    video.frame = video.pixels = video.atlas = video.chroma_atlas = NULL;
+    video.atlas_count = 0;
+    video.shades_mode = -1;
+}
+
+static size_t video_bytes_written(void)
+{
+    return atomic_load_explicit(&video.bytes_out, memory_order_relaxed);
+}
+
+const Renderer ppm_renderer = {
+    .name = "ppm",
+    .offscreen = true,
+    .init = ppm_init,
+    .present = video_present,
+    .resize = video_resize,
+    .shutdown = video_shutdown,
+    .bytes_written = video_bytes_written,
+};
+
+const Renderer y4m_renderer = {
+    .name = "y4m",
+    .offscreen = true,
+    .init = y4m_init,
+    .present = video_present,
+    .resize = video_resize,
+    .shutdown = video_shutdown,
+    .bytes_written = video_bytes_written,
+};
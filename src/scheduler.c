@@ -0,0 +1,107 @@
+#include <errno.h>
+#include <time.h>
+
+#include "scheduler.h"
+
+#define NS_PER_SEC 1000000000LL
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/* Returns 0 at the deadline, -1 if a signal arrived first. */
+static int sleep_until(int64_t deadline_ns)
+{
+#ifdef TIMER_ABSTIME
+    const struct timespec ts = {deadline_ns / NS_PER_SEC, deadline_ns % NS_PER_SEC};
+    int err;
+    while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) != 0)
+    {
+        if (err == EINTR)
+            return -1;
+    }
+    return 0;
+#else
+    // No absolute sleep (macOS): a relative one, recomputed from the deadline
+    const int64_t remaining = deadline_ns - now_ns();
+    if (remaining <= 0)
+        return 0;
+    const struct timespec ts = {remaining / NS_PER_SEC, remaining % NS_PER_SEC};
+    return nanosleep(&ts, NULL) == 0 ? 0 : -1;
+#endif
+}
+
+void scheduler_init(FrameScheduler *scheduler, int period_ms, FramePolicy policy)
+{
+    *scheduler = (FrameScheduler){0};
+    scheduler->period_ns = (period_ms > 0 ? period_ms : 1) * 1000000LL;
+    scheduler->policy = policy;
+    scheduler->deadline_ns = now_ns() + scheduler->period_ns;
+}
+
+void scheduler_set_period(FrameScheduler *scheduler, int period_ms)
+{
+    scheduler->period_ns = (period_ms > 0 ? period_ms : 1) * 1000000LL;
+}
+
+int scheduler_wait(FrameScheduler *scheduler)
+{
+    const bool overran = scheduler_overran(scheduler);
+    if (!overran && sleep_until(scheduler->deadline_ns) != 0)
+        return 0;
+    return scheduler_take(scheduler, overran);
+}
+
+bool scheduler_overran(const FrameScheduler *scheduler)
+{
+    return now_ns() > scheduler->deadline_ns;
+}
+
+int scheduler_take(FrameScheduler *scheduler, bool overran)
+{
+    const int64_t period = scheduler->period_ns;
+    const int64_t now = now_ns();
+
+    if (!overran)
+    {
+        const int64_t late = now - scheduler->deadline_ns;
+        scheduler->jitter_total_ns += late;
+        if (late > scheduler->jitter_max_ns)
+            scheduler->jitter_max_ns = late;
+
+        scheduler->frames++;
+        scheduler->deadline_ns += period;
+        return 1;
+    }
+
+    // The frame overran its deadline: run now, and account for any whole
+    // periods that went by without a frame
+    const int64_t lost = (now - scheduler->deadline_ns) / period;
+    scheduler->missed++;
+
+    if (scheduler->policy == FRAME_CATCH_UP && lost < SCHEDULER_MAX_CATCH_UP)
+    {
+        scheduler->deadline_ns += (lost + 1) * period;
+        return 1 + (int)lost;
+    }
+
+    if (scheduler->policy == FRAME_SKIP)
+    {
+        scheduler->deadline_ns += (lost + 1) * period;
+    }
+    else
+    {
+        // Too far behind to catch up (e.g. the process was stopped)
+        scheduler->deadline_ns = now + period;
+    }
+    scheduler->dropped += lost;
+    return 1;
+}
+
+void scheduler_restart(FrameScheduler *scheduler)
+{
+    scheduler->deadline_ns = now_ns() + scheduler->period_ns;
+}
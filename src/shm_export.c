@@ -0,0 +1,152 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "shm_export.h"
+
+// Slots start on a cache line, so writing one never touches a line of its neighbour
+#define SLOT_ALIGN 64
+
+static size_t align_up(size_t n)
+{
+    return (n + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+}
+
+static size_t slot_bytes_for(const Grid *grid)
+{
+    return align_up(sizeof(ShmExportSlot) + grid_bytes(grid));
+}
+
+static ShmExportSlot *slot_at(const ShmExport *shm, uint64_t frame)
+{
+    const size_t index = frame % SHM_EXPORT_SLOTS;
+    return (ShmExportSlot *)((uint8_t *)shm->header + shm->header->slot_offset + index * shm->slot_bytes);
+}
+
+/* Size the object for slots of slot_bytes and map it again. */
+static int map_slots(ShmExport *shm, size_t slot_bytes)
+{
+    const size_t map_bytes = align_up(sizeof(ShmExportHeader)) + SHM_EXPORT_SLOTS * slot_bytes;
+    if (ftruncate(shm->fd, (off_t)map_bytes) != 0)
+        return -1;
+
+    void *map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    if (shm->header)
+        munmap(shm->header, shm->map_bytes);
+    shm->header = map;
+    shm->map_bytes = map_bytes;
+    shm->slot_bytes = slot_bytes;
+    return 0;
+}
+
+/* Append the palette entries readers don't have yet. */
+static void publish_symbols(ShmExport *shm, const Palette *palette)
+{
+    ShmExportHeader *header = shm->header;
+    const uint32_t known = atomic_load_explicit(&header->symbol_count, memory_order_relaxed);
+    const size_t count = palette->count < SHM_EXPORT_MAX_SYMBOLS ? palette->count : SHM_EXPORT_MAX_SYMBOLS;
+    if (count <= known)
+        return;
+
+    for (size_t i = known; i < count; i++)
+        header->symbols[i] = (uint32_t)palette->symbols[i];
+    atomic_store_explicit(&header->symbol_count, (uint32_t)count, memory_order_release);
+}
+
+int shm_export_open(ShmExport *shm, const char *name, const Grid *grid, const Palette *palette)
+{
+    *shm = (ShmExport){.fd = -1};
+    if (strlen(name) >= sizeof(shm->name))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(shm->name, name);
+
+    shm_unlink(name); // Left over from a run that did not get to clean up
+    shm->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (shm->fd < 0 || map_slots(shm, slot_bytes_for(grid)) != 0)
+    {
+        const int saved_errno = errno;
+        shm_export_close(shm);
+        errno = saved_errno;
+        return -1;
+    }
+
+    // The object starts out zeroed: no frame, every slot empty
+    ShmExportHeader *header = shm->header;
+    header->magic = SHM_EXPORT_MAGIC;
+    header->version = SHM_EXPORT_VERSION;
+    header->slot_count = SHM_EXPORT_SLOTS;
+    header->max_symbols = SHM_EXPORT_MAX_SYMBOLS;
+    header->slot_offset = align_up(sizeof(ShmExportHeader));
+    header->color_mode = palette->color_mode;
+    header->shade_count = (uint32_t)palette->shade_count;
+    memcpy(header->shade_rgb, palette->shade_rgb, sizeof(header->shade_rgb));
+    atomic_store_explicit(&header->slot_bytes, shm->slot_bytes, memory_order_relaxed);
+    atomic_store_explicit(&header->map_bytes, shm->map_bytes, memory_order_relaxed);
+    publish_symbols(shm, palette);
+    return 0;
+}
+
+/* Make the slots big enough for grid. Readers see geometry odd meanwhile,
+ * and every slot empty after, since the old frames are not where they were.
+ */
+static int grow_slots(ShmExport *shm, const Grid *grid)
+{
+    ShmExportHeader *header = shm->header;
+    const uint64_t geometry = atomic_load_explicit(&header->geometry, memory_order_relaxed);
+    atomic_store_explicit(&header->geometry, geometry + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (map_slots(shm, slot_bytes_for(grid)) != 0)
+        return -1;
+    header = shm->header;
+    for (uint64_t i = 0; i < SHM_EXPORT_SLOTS; i++)
+        memset(slot_at(shm, i), 0, sizeof(ShmExportSlot));
+    atomic_store_explicit(&header->slot_bytes, shm->slot_bytes, memory_order_relaxed);
+    atomic_store_explicit(&header->map_bytes, shm->map_bytes, memory_order_relaxed);
+
+    atomic_store_explicit(&header->geometry, geometry + 2, memory_order_release);
+    return 0;
+}
+
+int shm_export_frame(ShmExport *shm, const Grid *grid, const Palette *palette)
+{
+    if (slot_bytes_for(grid) > shm->slot_bytes && grow_slots(shm, grid) != 0)
+        return -1;
+    publish_symbols(shm, palette);
+
+    // The seqlock: odd before the copy, even again after, and the frame published last
+    const uint64_t frame = ++shm->frame;
+    ShmExportSlot *slot = slot_at(shm, frame);
+    const uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->frame = frame;
+    slot->width = (uint32_t)grid->width;
+    slot->height = (uint32_t)grid->height;
+    slot->layout = (uint32_t)grid->layout;
+    memcpy(slot + 1, grid->glyph, grid_bytes(grid)); // Both planes, one block
+
+    atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+    atomic_store_explicit(&shm->header->frame, frame, memory_order_release);
+    return 0;
+}
+
+void shm_export_close(ShmExport *shm)
+{
+    if (shm->header)
+        munmap(shm->header, shm->map_bytes);
+    if (shm->fd >= 0)
+    {
+        close(shm->fd);
+        shm_unlink(shm->name);
+    }
+    *shm = (ShmExport){.fd = -1};
+}
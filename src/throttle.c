@@ -0,0 +1,85 @@
+#include <sys/ioctl.h>
+#include <time.h>
+
+#include "rain.h"
+#include "throttle.h"
+
+#define NS_PER_SEC 1000000000LL
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+void throttle_init(Throttle *throttle, int fd, int budget, const Renderer *renderer)
+{
+    *throttle = (Throttle){0};
+    throttle->fd = fd;
+    throttle->budget = budget;
+    throttle->window_start_ns = now_ns();
+    throttle->window_bytes = renderer->bytes_written ? renderer->bytes_written() : 0;
+}
+
+void throttle_begin_output(Throttle *throttle)
+{
+    throttle->output_start_ns = now_ns();
+}
+
+void throttle_end_output(Throttle *throttle)
+{
+    throttle->blocked_ns += now_ns() - throttle->output_start_ns;
+}
+
+/* Bytes written to fd that the driver has not sent yet; 0 where it can't tell. */
+static int queued_bytes(int fd)
+{
+#ifdef TIOCOUTQ
+    int queued;
+    if (ioctl(fd, TIOCOUTQ, &queued) == 0)
+        return queued;
+#endif
+    return 0;
+}
+
+int throttle_update(Throttle *throttle, const Renderer *renderer)
+{
+    const int64_t now = now_ns();
+    const int64_t elapsed = now - throttle->window_start_ns;
+    if (elapsed < THROTTLE_WINDOW_NS)
+        return throttle->level;
+
+    const size_t bytes = renderer->bytes_written ? renderer->bytes_written() : 0;
+    const int64_t rate = (int64_t)(bytes - throttle->window_bytes) * NS_PER_SEC / elapsed;
+    const int64_t queue_limit = throttle->budget ? throttle->budget / 8 : THROTTLE_QUEUE_LIMIT;
+
+    const bool blocked = throttle->blocked_ns > elapsed / 4;
+    const bool backlog = queued_bytes(throttle->fd) > queue_limit;
+    const bool over_budget = throttle->budget && rate > throttle->budget;
+
+    if (blocked || backlog || over_budget)
+    {
+        throttle->calm_windows = 0;
+        if (throttle->level < RAIN_LOAD_LEVELS - 1)
+            throttle->level++;
+    }
+    else if (!throttle->budget || rate < throttle->budget * 3 / 4)
+    {
+        // The next level up sends more, so it needs headroom under the budget
+        if (throttle->level > 0 && ++throttle->calm_windows >= THROTTLE_CALM_WINDOWS)
+        {
+            throttle->level--;
+            throttle->calm_windows = 0;
+        }
+    }
+    else
+    {
+        throttle->calm_windows = 0;
+    }
+
+    throttle->window_start_ns = now;
+    throttle->blocked_ns = 0;
+    throttle->window_bytes = bytes;
+    return throttle->level;
+}
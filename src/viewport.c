@@ -0,0 +1,225 @@
+#include <string.h>
+
+#include "palette.h"
+#include "viewport.h"
+
+// A following view closes this fraction of the distance to the message every frame
+#define FOLLOW_EASE 8
+
+static int max_x(const Viewport *vp)
+{
+    return vp->canvas_width > vp->grid.width ? vp->canvas_width - vp->grid.width : 0;
+}
+
+static int max_y(const Viewport *vp)
+{
+    return vp->canvas_height > vp->grid.height ? vp->canvas_height - vp->grid.height : 0;
+}
+
+static int clamp(int value, int lo, int hi)
+{
+    return value < lo ? lo : value > hi ? hi : value;
+}
+
+/* Put the view's top left at x,y, as near as the canvas allows. */
+static void place(Viewport *vp, int x, int y)
+{
+    vp->x = clamp(x, 0, max_x(vp));
+    vp->y = clamp(y, 0, max_y(vp));
+    vp->pan_x = vp->x;
+    vp->moved = true;
+}
+
+int viewport_init(Viewport *vp, const Settings *settings, int width, int height, int canvas_width,
+                  int canvas_height)
+{
+    *vp = (Viewport){0};
+    vp->canvas_width = canvas_width;
+    vp->canvas_height = canvas_height;
+    vp->pan_direction = 1;
+    if (grid_init(&vp->grid, width, height, (GridLayout)settings->grid_layout) != 0 ||
+        dirty_map_init(&vp->dirty, width, height) != 0)
+    {
+        viewport_free(vp);
+        return -1;
+    }
+
+    viewport_apply_settings(vp, settings);
+    place(vp, vp->start_x, vp->start_y);
+    return 0;
+}
+
+void viewport_free(Viewport *vp)
+{
+    grid_free(&vp->grid);
+    dirty_map_free(&vp->dirty);
+    *vp = (Viewport){0};
+}
+
+int viewport_resize(Viewport *vp, int width, int height)
+{
+    Grid grid;
+    DirtyMap dirty;
+    if (grid_init(&grid, width, height, vp->grid.layout) != 0)
+        return -1;
+    if (dirty_map_init(&dirty, width, height) != 0)
+    {
+        grid_free(&grid);
+        return -1;
+    }
+
+    grid_free(&vp->grid);
+    dirty_map_free(&vp->dirty);
+    vp->grid = grid;
+    vp->dirty = dirty;
+    place(vp, vp->x, vp->y);
+    return 0;
+}
+
+void viewport_apply_settings(Viewport *vp, const Settings *settings)
+{
+    vp->pan_speed = settings->pan_speed;
+
+    // A new mode or starting point starts the view over from there
+    if (settings->viewport != (int)vp->mode || settings->viewport_x != vp->start_x ||
+        settings->viewport_y != vp->start_y)
+    {
+        vp->mode = (ViewportMode)settings->viewport;
+        vp->start_x = settings->viewport_x;
+        vp->start_y = settings->viewport_y;
+        place(vp, vp->start_x, vp->start_y);
+    }
+}
+
+/* One frame closer to target: a share of the distance, but never less than a cell. */
+static int ease(int from, int target)
+{
+    const int step = (target - from) / FOLLOW_EASE;
+    if (step != 0)
+        return from + step;
+    return from + (target > from) - (target < from);
+}
+
+void viewport_move(Viewport *vp, int steps, int focus_row, int focus_col)
+{
+    const int x = vp->x;
+    const int y = vp->y;
+
+    if (vp->mode == VIEWPORT_PAN)
+    {
+        // Bounces off either side; a speed past the whole width just ends up at the far side
+        const double room = max_x(vp);
+        vp->pan_x += vp->pan_speed * vp->pan_direction * steps;
+        if (vp->pan_x > room)
+        {
+            vp->pan_x = room - (vp->pan_x - room);
+            vp->pan_direction = -1;
+        }
+        if (vp->pan_x < 0)
+        {
+            vp->pan_x = -vp->pan_x;
+            vp->pan_direction = 1;
+        }
+        if (vp->pan_x > room)
+            vp->pan_x = room;
+        vp->x = (int)vp->pan_x;
+    }
+    else if (vp->mode == VIEWPORT_FOLLOW)
+    {
+        const int target_x = clamp(focus_col - vp->grid.width / 2, 0, max_x(vp));
+        const int target_y = clamp(focus_row - vp->grid.height / 2, 0, max_y(vp));
+        for (int i = 0; i < steps; i++)
+        {
+            vp->x = ease(vp->x, target_x);
+            vp->y = ease(vp->y, target_y);
+        }
+    }
+
+    if (vp->x != x || vp->y != y)
+        vp->moved = true;
+}
+
+/* Copy the canvas cell under row,col of the view. Past the canvas, and where
+ * the view's edge cuts a wide glyph in half, the view shows a blank.
+ */
+static void show_cell(Viewport *vp, const Grid *canvas, int row, int col)
+{
+    Grid *view = &vp->grid;
+    const int canvas_row = vp->y + row;
+    const int canvas_col = vp->x + col;
+    uint16_t glyph = GLYPH_EMPTY;
+    uint8_t color = 0;
+
+    if (canvas_row < canvas->height && canvas_col < canvas->width)
+    {
+        const size_t from = grid_index(canvas, canvas_row, canvas_col);
+        glyph = canvas->glyph[from];
+        color = canvas->color[from];
+        if (((color & CELL_WIDE) && col == view->width - 1) || ((color & CELL_CONT) && col == 0))
+        {
+            glyph = GLYPH_EMPTY;
+            color = 0;
+        }
+    }
+
+    const size_t to = grid_index(view, row, col);
+    view->glyph[to] = glyph;
+    view->color[to] = color;
+}
+
+void viewport_sync(Viewport *vp, const Grid *canvas, DirtyMap *canvas_dirty)
+{
+    const Grid *view = &vp->grid;
+
+    if (vp->moved)
+    {
+        for (int row = 0; row < view->height; row++)
+        {
+            for (int col = 0; col < view->width; col++)
+                show_cell(vp, canvas, row, col);
+            dirty_map_mark(&vp->dirty, row, 0, view->width);
+        }
+        vp->moved = false;
+    }
+    else
+    {
+        // Only the changed canvas cells under the view are looked at
+        const int rows = canvas->height - vp->y < view->height ? canvas->height - vp->y : view->height;
+        const int cols = canvas->width - vp->x < view->width ? canvas->width - vp->x : view->width;
+        for (int row = 0; row < rows; row++)
+        {
+            const DirtySpan *span = &canvas_dirty->spans[vp->y + row];
+            const int lo = span->lo > vp->x ? span->lo : vp->x;
+            const int hi = span->hi < vp->x + cols ? span->hi : vp->x + cols;
+            if (lo >= hi)
+                continue;
+
+            const uint64_t *bits = canvas_dirty->bits + (size_t)(vp->y + row) * canvas_dirty->words_per_row;
+            for (int w = lo / 64; w <= (hi - 1) / 64; w++)
+            {
+                uint64_t word = bits[w];
+                if (w == lo / 64)
+                    word &= ~(uint64_t)0 << (lo % 64);
+                if (w == (hi - 1) / 64 && hi % 64)
+                    word &= ~(~(uint64_t)0 << (hi % 64));
+                for (; word; word &= word - 1)
+                {
+                    const int col = w * 64 + __builtin_ctzll(word) - vp->x;
+                    show_cell(vp, canvas, row, col);
+                    dirty_map_mark(&vp->dirty, row, col, col + 1);
+                }
+            }
+        }
+    }
+
+    // What the canvas diff would have cleared: the words under each row's span
+    for (int row = 0; row < canvas->height; row++)
+    {
+        DirtySpan *span = &canvas_dirty->spans[row];
+        if (span->lo >= span->hi)
+            continue;
+        uint64_t *bits = canvas_dirty->bits + (size_t)row * canvas_dirty->words_per_row;
+        memset(bits + span->lo / 64, 0, ((span->hi - 1) / 64 - span->lo / 64 + 1) * sizeof(uint64_t));
+        *span = (DirtySpan){canvas->width, 0};
+    }
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "watch.h"
+
+static struct timespec modification_time(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return (struct timespec){0};
+#ifdef __APPLE__
+    return st.st_mtimespec;
+#else
+    return st.st_mtim;
+#endif
+}
+
+int file_watch_init(FileWatch *watch, const char *path)
+{
+    watch->fd = -1;
+    if (strlen(path) >= sizeof(watch->path))
+        return -1;
+    strcpy(watch->path, path);
+
+    char *slash = strrchr(watch->path, '/');
+    watch->name = slash ? slash + 1 : watch->path;
+    watch->mtime = modification_time(path);
+
+#ifdef __linux__
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0)
+        return 0; // Fall back to comparing modification times
+
+    char dir[PATH_MAX];
+    if (slash)
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - watch->path), watch->path);
+    else
+        strcpy(dir, ".");
+
+    // Only finished writes: IN_MODIFY would also fire halfway through a save
+    if (inotify_add_watch(watch->fd, slash && slash == watch->path ? "/" : dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(watch->fd);
+        watch->fd = -1;
+    }
+#endif
+    return 0;
+}
+
+void file_watch_free(FileWatch *watch)
+{
+    if (watch->fd >= 0)
+        close(watch->fd);
+    watch->fd = -1;
+}
+
+bool file_watch_changed(FileWatch *watch)
+{
+    bool changed = false;
+
+#ifdef __linux__
+    if (watch->fd >= 0)
+    {
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t len;
+        while ((len = read(watch->fd, events, sizeof(events))) > 0)
+        {
+            for (char *p = events; p < events + len;)
+            {
+                const struct inotify_event *event = (const struct inotify_event *)p;
+                if (event->len > 0 && strcmp(event->name, watch->name) == 0)
+                    changed = true;
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+#endif
+
+    const struct timespec mtime = modification_time(watch->path);
+    if (mtime.tv_sec != watch->mtime.tv_sec || mtime.tv_nsec != watch->mtime.tv_nsec)
+    {
+        watch->mtime = mtime;
+        changed = true;
+    }
+    return changed;
+}
@@ -0,0 +1,112 @@
+#include <stdlib.h>
+
+#include "workers.h"
+
+struct WorkerThread
+{
+    pthread_t thread;
+    WorkerPool *pool;
+    int index;
+};
+
+static void *worker_main(void *arg)
+{
+    WorkerThread *self = arg;
+    WorkerPool *pool = self->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    unsigned long seen = 0; // Not pool->generation: a task may already have been posted
+    while (1)
+    {
+        while (pool->generation == seen && !pool->stop)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stop)
+            break;
+        seen = pool->generation;
+
+        const WorkerTask task = pool->task;
+        void *ctx = pool->ctx;
+        pthread_mutex_unlock(&pool->lock);
+
+        task(ctx, self->index, pool->count);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int worker_pool_init(WorkerPool *pool, int count)
+{
+    *pool = (WorkerPool){0};
+    pool->count = 1;
+    if (count <= 1)
+        return 0;
+
+    pool->threads = calloc(count - 1, sizeof(WorkerThread));
+    if (!pool->threads)
+        return -1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int i = 1; i < count; i++)
+    {
+        WorkerThread *thread = &pool->threads[i - 1];
+        thread->pool = pool;
+        thread->index = i;
+        if (pthread_create(&thread->thread, NULL, worker_main, thread) != 0)
+        {
+            worker_pool_free(pool);
+            return -1;
+        }
+        pool->count++;
+    }
+    return 0;
+}
+
+void worker_pool_free(WorkerPool *pool)
+{
+    if (pool->threads)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->stop = true;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (int i = 1; i < pool->count; i++)
+            pthread_join(pool->threads[i - 1].thread, NULL);
+
+        pthread_cond_destroy(&pool->done);
+        pthread_cond_destroy(&pool->start);
+        pthread_mutex_destroy(&pool->lock);
+        free(pool->threads);
+    }
+    *pool = (WorkerPool){0};
+}
+
+void worker_pool_run(WorkerPool *pool, WorkerTask task, void *ctx)
+{
+    if (pool->count <= 1)
+    {
+        task(ctx, 0, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->running = pool->count - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    task(ctx, 0, pool->count);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}